@@ -1,120 +1,482 @@
 #include "L1simulate.hpp"
+#include "checkpoint.hpp"
+#include "metrics.hpp"
+#include "mrc.hpp"
+#include "sampling.hpp"
+#include "sharing.hpp"
+#include "split_bus.hpp"
+#include "sweep.hpp"
 
-struct TraceEntry {
-    char op; // 'R' or 'W'
-    uint32_t addr;
-};
+#include <unistd.h>
 
-std::vector<TraceEntry> read_trace(const std::string& filename) {
-    std::vector<TraceEntry> trace;
-    std::ifstream fin(filename);
-    std::string line;
-    while (std::getline(fin, line)) {
-        std::istringstream iss(line);
-        char op;
-        std::string addr_str;
-        if (!(iss >> op >> addr_str)) continue;
-        uint32_t addr = std::stoul(addr_str, nullptr, 16);
-        trace.push_back({op, addr});
-    }
-    return trace;
-}
+#include <memory>
 
 void print_help() {
-    std::cout << "Usage: ./L1simulate -t <tracefile> -s <s> -E <E> -b <b> -o <outfilename> [-h]\n";
+    std::cout << "Usage: ./L1simulate -t <tracefile> -s <s> -E <E> -b <b> -o <outfilename> [-n <cores>] [-h]\n";
+    std::cout << "       ./L1simulate -c <tracefile>\n";
     std::cout << "  -t <tracefile>   : name of parallel application (e.g. app1)\n";
     std::cout << "  -s <s>           : number of set index bits (number of sets = 2^s)\n";
     std::cout << "  -E <E>           : associativity (number of cache lines per set)\n";
     std::cout << "  -b <b>           : number of block bits (block size = 2^b)\n";
+    std::cout << "                     -s/-E/-b also take lists (1,2,4) or ranges (4-8); several values run a sweep\n";
+    std::cout << "                     and write one CSV result table to -o (JSON if it ends in .json)\n";
+    std::cout << "  -j <threads>     : worker threads for loading traces, a sweep or the parallel engine\n";
+    std::cout << "                     (default: all hardware threads)\n";
     std::cout << "  -o <outfilename> : output log file\n";
+    std::cout << "  -n <cores>       : number of cores (default 4); core i reads <tracefile>_proc<i>.trace\n";
+    std::cout << "  -c <tracefile>   : convert <tracefile>_procN.trace to the binary <tracefile>_procN.btrace format and exit\n";
+    std::cout << "                     (binary traces are memory-mapped and preferred over text traces when present)\n";
+    std::cout << "  --engine <name>  : step (advance one cycle at a time), event (skip stalled cycles and batch private\n";
+    std::cout << "                     hits, default) or parallel (event, with per-core work split over -j threads)\n";
+    std::cout << "  --protocol <name>: coherence protocol: mesi (default), moesi (dirty sharing without memory\n";
+    std::cout << "                     writebacks) or mesif (one forwarder supplies clean shared blocks)\n";
+    std::cout << "  --snoop-filter   : track block holders so snoops only probe caches that hold the block\n";
+    std::cout << "  --split-bus      : split-transaction bus with several requests in flight instead of the atomic bus\n";
+    std::cout << "  --outstanding <n>: split bus transactions in flight at once (default 4)\n";
+    std::cout << "  --arbitration <policy> : split bus grant order, rr (round-robin, default) or age (oldest first)\n";
+    std::cout << "  --mshrs <n>      : split bus: non-blocking L1s with <n> MSHRs each (1-32, default: blocking L1s)\n";
+    std::cout << "  --store-buffer <n>       : store buffer entries of a non-blocking L1 (1-64, default 8)\n";
+    std::cout << "  --llc <KB>       : shared last-level cache of <KB> KB between the bus and memory (default: none)\n";
+    std::cout << "  --llc-ways <n>   : LLC associativity (default 16)\n";
+    std::cout << "  --llc-banks <n>  : LLC banks, each serving one access at a time (default 4)\n";
+    std::cout << "  --llc-latency <cycles>   : cycles per LLC access (default 20)\n";
+    std::cout << "  --llc-policy <policy>    : nine (default), inclusive (also the snoop directory with --snoop-filter)\n";
+    std::cout << "                     or exclusive\n";
+    std::cout << "  --replacement <p>: L1 replacement policy: lru (default), plru (tree pseudo-LRU), srrip, brrip\n";
+    std::cout << "                     or random; a comma list (lru,plru,srrip) runs a sweep over the policies\n";
+    std::cout << "  --prefetch <kind>: L1 prefetcher per core: next-line, stride or stream (default: none)\n";
+    std::cout << "  --prefetch-degree <n>    : blocks each prefetcher predicts at a time (default 2)\n";
+    std::cout << "  --metrics <file> : write sampled per-core miss rates, bus occupancy, queue depth and latency histograms\n";
+    std::cout << "                     (CSV, with histograms in <file stem>_hist.csv, or JSON if <file> ends in .json)\n";
+    std::cout << "  --sample <cycles>: cycles between metrics samples (default 10000)\n";
+    std::cout << "  --checkpoint <file>      : checkpoint file written by --checkpoint-at, --checkpoint-every and SIGUSR1\n";
+    std::cout << "  --checkpoint-at <cycle>  : write a checkpoint when the run reaches <cycle>, then stop\n";
+    std::cout << "  --checkpoint-every <n>   : write a checkpoint every <n> cycles and keep running\n";
+    std::cout << "  --restore <file>         : continue from a checkpoint (same traces, -n, -s, -E, -b and bus model)\n";
+    std::cout << "  --sampling <n>   : sampled run: of every <n> cycles simulate only warm-up + detail cycle by cycle,\n";
+    std::cout << "                     warm the caches functionally through the rest, then extrapolate\n";
+    std::cout << "  --sampling-warmup <n>    : detailed but unmeasured cycles before each window (default 20000)\n";
+    std::cout << "  --sampling-detail <n>    : measured cycles per window (default 10000)\n";
+    std::cout << "  --sharing <n>    : report the <n> blocks with the most coherence traffic, per core pair, with the\n";
+    std::cout << "                     byte offsets each core touched and a true/false sharing verdict\n";
+    std::cout << "  --mrc            : instead of simulating, write miss-ratio curves for every -s/-E/-b combination\n";
+    std::cout << "                     to -o from one stack-distance pass over the traces (JSON if it ends in .json)\n";
+    std::cout << "  --stream         : read traces in fixed-size chunks on background threads instead of loading them whole\n";
+    std::cout << "  -p <core>=<path> : stream core <core>'s trace from <path> (file, named pipe, or - for stdin); implies --stream\n";
+    std::cout << "  --verbose        : print the tag-scan kernel each configuration uses to stderr\n";
     std::cout << "  -h               : print this help message\n";
 }
 
-void print_stats(const std::vector<L1Cache>& caches, uint64_t total_bus_transactions, uint64_t total_bus_traffic_bytes) {
-    std::cout << "Simulation Parameters:\n";
-    std::cout << "Trace Prefix: " << tracefile << "\n";
-    std::cout << "Set Index Bits: " << s << "\n";
-    std::cout << "Associativity: " << E << "\n";
-    std::cout << "Block Bits: " << b << "\n";
-    std::cout << "Block Size (Bytes): " << (1 << b) << "\n";
-    std::cout << "Number of Sets: " << (1 << s) << "\n";
-    std::cout << "Cache Size (KB per core): " << ((1 << s) * E * (1 << b)) / 1024 << "\n";
-    std::cout << "MESI Protocol: Enabled\n";
-    std::cout << "Write Policy: Write-back, Write-allocate\n";
-    std::cout << "Replacement Policy: LRU\n";
-    std::cout << "Bus: Central snooping bus\n\n";
-
-    for (int i = 0; i < NUM_CORES; ++i) {
+// Tag scan used by the run: the inline compares of a specialised geometry or, on the generic
+// path, the kernel picked for the running CPU (a scalar loop below SIMD_MIN_WAYS ways)
+static std::string way_scan_kernel(const SimConfig& config) {
+    std::string kernel;
+    with_geometry(config.E, config.b, [&](auto geometry) {
+        using G = decltype(geometry);
+        if constexpr (G::WAYS > 0) {
+#if defined(__SSE2__) && !defined(L1SIM_SCALAR)
+            kernel = G::WAYS >= 4 ? "sse2" : "scalar";
+#else
+            kernel = "scalar";
+#endif
+            kernel += " (inline, " + std::to_string(G::WAYS) + "-way)";
+        } else {
+            kernel = config.E >= SIMD_MIN_WAYS ? simd_kernel_name() : "scalar";
+        }
+    });
+    return kernel;
+}
+
+void print_stats(const Simulator& sim, std::ostream& out) {
+    const SimConfig& config = sim.config();
+    const CacheController& controller = sim.controller;
+    const std::vector<L1Cache>& caches = controller.l1_caches;
+    const int s = config.s, E = config.E, b = config.b;
+    out << "Simulation Parameters:\n";
+    out << "Trace Prefix: " << config.tracefile << "\n";
+    out << "Set Index Bits: " << s << "\n";
+    out << "Associativity: " << E << "\n";
+    out << "Block Bits: " << b << "\n";
+    out << "Block Size (Bytes): " << (1 << b) << "\n";
+    out << "Number of Sets: " << (1 << s) << "\n";
+    out << "Cache Size (KB per core): " << ((1 << s) * E * (1 << b)) / 1024 << "\n";
+    static const char* const protocol_names[] = {"MESI", "MOESI", "MESIF"};
+    out << protocol_names[static_cast<int>(config.protocol)] << " Protocol: Enabled\n";
+    out << "Write Policy: Write-back, Write-allocate\n";
+    out << "Replacement Policy: " << replacement_name(config.replacement) << "\n";
+    if (config.prefetch != PrefetchKind::NONE) {
+        static const char* const prefetch_names[] = {"none", "next-line", "stride", "stream"};
+        out << "Prefetcher: " << prefetch_names[static_cast<int>(config.prefetch)] << " (degree "
+            << config.prefetch_degree << ")\n";
+    }
+    if (config.split_bus) {
+        out << "Bus: Split-transaction snooping bus (" << config.bus_outstanding << " outstanding, "
+            << (config.arbitration == Arbitration::AGE ? "age" : "round-robin") << " arbitration)\n";
+        if (config.mshrs) {
+            out << "L1: Non-blocking (" << config.mshrs << " MSHRs, " << config.store_buffer
+                << "-entry store buffer)\n";
+        }
+        out << "\n";
+    } else {
+        out << "Bus: Central snooping bus\n\n";
+    }
+
+    for (int i = 0; i < config.num_cores; ++i) {
         const auto& stats = caches[i].stats;
-        std::cout << "Core " << i << " Statistics:\n";
-        std::cout << "Total Instructions: " << stats.total_instructions << "\n";
-        std::cout << "Total Reads: " << stats.total_reads << "\n";
-        std::cout << "Total Writes: " << stats.total_writes << "\n";
-        std::cout << "Total Execution Cycles: " << stats.total_cycles << "\n";
-        std::cout << "Idle Cycles: " << stats.idle_cycles << "\n";
-        std::cout << "Cache Misses: " << stats.cache_misses << "\n";
+        out << "Core " << i << " Statistics:\n";
+        out << "Total Instructions: " << stats.total_instructions << "\n";
+        out << "Total Reads: " << stats.total_reads << "\n";
+        out << "Total Writes: " << stats.total_writes << "\n";
+        out << "Total Execution Cycles: " << stats.total_cycles << "\n";
+        out << "Idle Cycles: " << stats.idle_cycles << "\n";
+        out << "Cache Misses: " << stats.cache_misses << "\n";
         double miss_rate = stats.total_instructions ? (100.0 * stats.cache_misses / stats.total_instructions) : 0.0;
-        std::cout << "Cache Miss Rate: " << std::fixed << std::setprecision(2) << miss_rate << "%\n";
-        std::cout << "Cache Evictions: " << stats.cache_evictions << "\n";
-        std::cout << "Writebacks: " << stats.writebacks << "\n";
-        std::cout << "Bus Invalidations: " << stats.bus_invalidations << "\n";
-        std::cout << "Data Traffic (Bytes): " << stats.data_traffic_bytes << "\n\n";
+        out << "Cache Miss Rate: " << std::fixed << std::setprecision(2) << miss_rate << "%\n";
+        out << "Cache Evictions: " << stats.cache_evictions << "\n";
+        out << "Writebacks: " << stats.writebacks << "\n";
+        out << "Bus Invalidations: " << stats.bus_invalidations << "\n";
+        out << "Data Traffic (Bytes): " << stats.data_traffic_bytes << "\n";
+        if (config.prefetch != PrefetchKind::NONE) {
+            out << "Prefetches Issued: " << stats.prefetches << "\n";
+            out << "Useful Prefetches: " << stats.prefetch_useful << "\n";
+            out << "Late Prefetches: " << stats.prefetch_late << "\n";
+            out << "Useless Prefetches: " << stats.prefetch_useless << "\n";
+            out << "Prefetch Traffic (Bytes): " << stats.prefetch_traffic_bytes << "\n";
+        }
+        out << "\n";
+    }
+    out << "Overall Bus Summary:\n";
+    out << "Total Bus Transactions: " << controller.total_bus_transactions << "\n";
+    out << "Total Bus Traffic (Bytes): " << controller.total_bus_traffic_bytes << "\n";
+
+    if (config.snoop_filter) {
+        const SnoopFilter::Stats& sf = controller.snoop_filter.stats;
+        double hit_rate = sf.lookups ? (100.0 * sf.hits / sf.lookups) : 0.0;
+        double miss_rate = sf.lookups ? (100.0 * sf.misses / sf.lookups) : 0.0;
+        out << "\nSnoop Filter Summary:\n";
+        out << "Snoop Filter Lookups: " << sf.lookups << "\n";
+        out << "Snoop Filter Hits: " << sf.hits << " (" << std::fixed << std::setprecision(2) << hit_rate << "%)\n";
+        out << "Snoop Filter Misses: " << sf.misses << " (" << miss_rate << "%)\n";
+        out << "Cache Probes Avoided: " << sf.probes_avoided << "\n";
+    }
+
+    if (sim.split_bus) {
+        const SplitBus& split = *sim.split_bus;
+        uint64_t cycles = std::max<uint64_t>(sim.global_cycle, 1);
+        out << "\nSplit Bus Summary:\n";
+        out << "Simulated Cycles: " << sim.global_cycle << "\n";
+        out << "Address Bus Grants: " << split.grants << "\n";
+        out << "Data Bus Busy Cycles: " << split.data_bus_cycles << " (" << std::fixed << std::setprecision(2)
+            << 100.0 * split.data_bus_cycles / cycles << "%)\n";
+        out << "Peak Transactions In Flight: " << split.max_in_flight << "\n";
+        out << "Peak Queue Depth: " << split.max_queue_depth << "\n";
+        for (int i = 0; i < config.num_cores; ++i) {
+            const SplitBusCoreStats& st = split.core_stats[i];
+            double avg_wait = st.requests ? static_cast<double>(st.queue_cycles) / st.requests : 0.0;
+            out << "Core " << i << ": Requests " << st.requests << ", Bus Utilisation " << 100.0 * st.data_bus_cycles / cycles
+                << "%, Avg Queueing Delay " << avg_wait << " cycles, Max Queueing Delay " << st.max_queue_cycles
+                << " cycles\n";
+        }
+    }
+
+    if (!sim.miss_handlers.empty()) {
+        uint64_t cycles = std::max<uint64_t>(sim.global_cycle, 1);
+        out << "\nNon-blocking L1 Summary:\n";
+        for (int i = 0; i < config.num_cores; ++i) {
+            const MissHandlerStats& st = sim.miss_handlers[i].stats;
+            double mlp = st.busy_cycles ? static_cast<double>(st.occupancy) / st.busy_cycles : 0.0;
+            out << "Core " << i << ": MSHR Misses " << st.primary_misses << ", Merged Misses " << st.merged_misses
+                << ", Avg MSHRs In Use " << std::fixed << std::setprecision(2)
+                << static_cast<double>(st.occupancy) / cycles << ", Peak " << st.max_in_use
+                << ", Memory-Level Parallelism " << mlp << ", MSHR-Full Cycles " << st.mshr_full_cycles
+                << ", Buffered Stores " << st.buffered_stores << ", Forwarded Loads " << st.forwarded_loads
+                << ", Buffer-Full Cycles " << st.buffer_full_cycles << "\n";
+        }
+    }
+
+    if (controller.llc.enabled()) {
+        static const char* const policy_names[] = {"NINE", "inclusive", "exclusive"};
+        out << "\nShared LLC Summary:\n";
+        out << "LLC: " << config.llc_kb << " KB, " << config.llc_ways << "-way, " << controller.llc.sets() << " sets, "
+            << config.llc_banks << " banks, " << config.llc_latency << "-cycle latency, "
+            << policy_names[static_cast<int>(config.llc_policy)]
+            << (controller.llc.is_directory() ? " (snoop directory)" : "") << "\n";
+        LLCBankStats total;
+        for (size_t i = 0; i < controller.llc.bank_stats.size(); ++i) {
+            const LLCBankStats& st = controller.llc.bank_stats[i];
+            out << "Bank " << i << ": Reads " << st.reads << ", Read Hits " << st.read_hits << " (" << std::fixed
+                << std::setprecision(2) << (st.reads ? 100.0 * st.read_hits / st.reads : 0.0) << "%), Writes "
+                << st.writes << ", Evictions " << st.evictions << ", Memory Writebacks " << st.memory_writebacks
+                << ", Back-Invalidations " << st.back_invalidations << ", Busy Cycles " << st.busy_cycles
+                << ", Conflict Cycles " << st.conflict_cycles << "\n";
+            total.reads += st.reads;
+            total.read_hits += st.read_hits;
+            total.memory_writebacks += st.memory_writebacks;
+            total.back_invalidations += st.back_invalidations;
+        }
+        out << "LLC Hit Rate: " << (total.reads ? 100.0 * total.read_hits / total.reads : 0.0) << "% (" << total.read_hits
+            << " of " << total.reads << " reads)\n";
+        out << "Memory Writebacks: " << total.memory_writebacks << "\n";
+        out << "Back-Invalidations: " << total.back_invalidations << "\n";
+    }
+
+    if (sim.profiler) sim.profiler->write(out);
+
+    if (sim.sampler) {
+        const Sampler& sampler = *sim.sampler;
+        uint64_t accesses = sampler.functional_accesses + sampler.detailed_accesses;
+        out << "\nSampling Summary (estimates with 95% confidence intervals):\n";
+        out << "Sampling Period: " << config.sampling_period << " cycles (" << config.sampling_warmup
+            << " warm-up, " << config.sampling_detail << " measured)\n";
+        out << "Accesses Simulated In Detail: " << sampler.detailed_accesses << " of " << accesses << " ("
+            << std::fixed << std::setprecision(2) << (accesses ? 100.0 * sampler.detailed_accesses / accesses : 0.0)
+            << "%)\n";
+        for (int i = 0; i < config.num_cores; ++i) {
+            const CoreEstimate& est = sampler.estimates[i];
+            out << "Core " << i << ": Windows " << est.windows << ", Execution Cycles " << std::setprecision(0)
+                << est.total_cycles.value << " +/- " << est.total_cycles.ci << ", Idle Cycles " << est.idle_cycles.value
+                << " +/- " << est.idle_cycles.ci << ", Miss Rate " << std::setprecision(2) << est.miss_rate.value
+                << "% +/- " << est.miss_rate.ci << "%\n";
+        }
+    }
+}
+
+const char* replacement_name(ReplacementPolicy policy) {
+    switch (policy) {
+    case ReplacementPolicy::LRU: return "LRU";
+    case ReplacementPolicy::PLRU: return "PLRU";
+    case ReplacementPolicy::SRRIP: return "SRRIP";
+    case ReplacementPolicy::BRRIP: return "BRRIP";
+    case ReplacementPolicy::RANDOM: return "Random";
+    }
+    return "";
+}
+
+// Smallest power of two >= n
+static int tree_leaves(int n) {
+    int leaves = 1;
+    while (leaves < n) leaves <<= 1;
+    return leaves;
+}
+
+L1Cache::L1Cache(int s_bits, int E, int b_bits, ReplacementPolicy policy)
+    : S(1 << s_bits), E(E), B(1 << b_bits), stride((E + CACHE_WAY_PAD - 1) / CACHE_WAY_PAD * CACHE_WAY_PAD),
+      policy(policy), plru_words(policy == ReplacementPolicy::PLRU ? (tree_leaves(E) + 63) / 64 : 0),
+      valid_words(policy == ReplacementPolicy::LRU ? 0 : (E + 63) / 64) {
+    allocate();
+    size_t lines = static_cast<size_t>(S) * stride;
+    for (size_t i = 0; i < lines; ++i) {
+        bool pad = static_cast<int>(i % stride) >= E;
+        tags[i] = 0;
+        states[i] = pad ? static_cast<MESIState>(PAD_STATE) : MESIState::INVALID;
+        if (ages) ages[i] = pad ? PAD_AGE : 0;
+        if (rrpv) rrpv[i] = 0;
+        prefetched[i] = 0;
+    }
+    if (plru) std::fill_n(plru, static_cast<size_t>(S) * plru_words, 0);
+    if (valid) std::fill_n(valid, static_cast<size_t>(S) * valid_words, 0);
+}
+
+L1Cache::L1Cache(const L1Cache& other)
+    : S(other.S), E(other.E), B(other.B), stride(other.stride), policy(other.policy), plru_words(other.plru_words),
+      valid_words(other.valid_words),
+      global_lru_counter(other.global_lru_counter), random_state(other.random_state),
+      brrip_fills(other.brrip_fills), stats(other.stats) {
+    allocate();
+    memcpy(storage, other.storage, storage_size());
+}
+
+L1Cache& L1Cache::operator=(const L1Cache& other) {
+    if (this == &other) return *this;
+    free(storage);
+    S = other.S;
+    E = other.E;
+    B = other.B;
+    stride = other.stride;
+    policy = other.policy;
+    plru_words = other.plru_words;
+    valid_words = other.valid_words;
+    global_lru_counter = other.global_lru_counter;
+    random_state = other.random_state;
+    brrip_fills = other.brrip_fills;
+    stats = other.stats;
+    allocate();
+    memcpy(storage, other.storage, storage_size());
+    return *this;
+}
+
+L1Cache::~L1Cache() {
+    free(storage);
+}
+
+// Tags, then states, then prefetch flags, then the policy's replacement state: LRU ages
+// (8 bytes per line), RRIP values (1 byte per line) or PLRU trees (plru_words per set),
+// then for every policy but LRU the valid-way masks; each array padded to a whole number
+// of 64-byte lines
+static size_t align64(size_t n) {
+    return (n + 63) & ~static_cast<size_t>(63);
+}
+
+size_t L1Cache::storage_size() const {
+    size_t lines = static_cast<size_t>(S) * stride;
+    size_t replacement = 0;
+    switch (policy) {
+    case ReplacementPolicy::LRU: replacement = lines * sizeof(uint64_t); break;
+    case ReplacementPolicy::SRRIP:
+    case ReplacementPolicy::BRRIP: replacement = lines; break;
+    case ReplacementPolicy::PLRU: replacement = static_cast<size_t>(S) * plru_words * sizeof(uint64_t); break;
+    case ReplacementPolicy::RANDOM: break;
+    }
+    return align64(lines * sizeof(uint32_t)) + align64(lines * sizeof(MESIState)) + align64(lines) +
+           align64(replacement) + align64(static_cast<size_t>(S) * valid_words * sizeof(uint64_t));
+}
+
+void L1Cache::allocate() {
+    size_t lines = static_cast<size_t>(S) * stride;
+    storage = static_cast<unsigned char*>(aligned_alloc(64, storage_size()));
+    if (!storage) {
+        std::cerr << "Error: out of memory allocating cache\n";
+        exit(1);
+    }
+    tags = reinterpret_cast<uint32_t*>(storage);
+    states = reinterpret_cast<MESIState*>(storage + align64(lines * sizeof(uint32_t)));
+    prefetched = reinterpret_cast<uint8_t*>(states) + align64(lines * sizeof(MESIState));
+    unsigned char* replacement = prefetched + align64(lines);
+    ages = policy == ReplacementPolicy::LRU ? reinterpret_cast<uint64_t*>(replacement) : nullptr;
+    rrpv = policy == ReplacementPolicy::SRRIP || policy == ReplacementPolicy::BRRIP ? replacement : nullptr;
+    plru = policy == ReplacementPolicy::PLRU ? reinterpret_cast<uint64_t*>(replacement) : nullptr;
+    size_t replacement_size = storage_size() - (replacement - storage) -
+                              align64(static_cast<size_t>(S) * valid_words * sizeof(uint64_t));
+    valid = valid_words ? reinterpret_cast<uint64_t*>(replacement + replacement_size) : nullptr;
+}
+
+void L1Cache::rebuild_valid() {
+    if (!valid) return;
+    for (int i = 0; i < S; ++i) {
+        CacheSet set = this->set(i);
+        std::fill_n(set.valid, valid_words, 0);
+        for (int way = 0; way < E; ++way) {
+            if (set.states[way] != MESIState::INVALID) set.valid[way / 64] |= uint64_t{1} << (way % 64);
+        }
+    }
+}
+
+// RRIP values: 0 (re-referenced soon) to RRPV_MAX (distant); FRESH marks a line whose fill
+// has not yet seen the access that missed on it, so that access does not count as a reuse
+static constexpr uint8_t RRPV_MAX = 3;
+static constexpr uint8_t RRPV_FRESH = 0x80;
+
+int L1Cache::policy_victim(const CacheSet& set) {
+    // The first way holding no block: the first clear bit of the valid-way mask
+    for (int w = 0; w < valid_words; ++w) {
+        uint64_t free = ~set.valid[w];
+        if (w == valid_words - 1 && set.ways % 64) free &= (uint64_t{1} << (set.ways % 64)) - 1;
+        if (free) return w * 64 + __builtin_ctzll(free);
+    }
+    switch (policy) {
+    case ReplacementPolicy::PLRU: {
+        // Follow the tree bits towards the less recently used half; halves made up only of
+        // ways past E (E not a power of two) are never chosen
+        int node = 1, first = 0, size = tree_leaves(set.ways);
+        while (size > 1) {
+            size /= 2;
+            bool right = set.plru[node / 64] >> (node % 64) & 1;
+            if (right && first + size < set.ways) {
+                first += size;
+                node = 2 * node + 1;
+            } else {
+                node = 2 * node;
+            }
+        }
+        return first;
+    }
+    case ReplacementPolicy::SRRIP:
+    case ReplacementPolicy::BRRIP:
+        // The first way predicted most distant; if none is at RRPV_MAX, age the whole set
+        // until one is
+        return rrip_victim(set.rrpv, set.ways, static_cast<uint8_t>(~RRPV_FRESH), RRPV_MAX);
+    case ReplacementPolicy::RANDOM: return static_cast<int>((random_state >> 32) % set.ways);
+    case ReplacementPolicy::LRU: break;
     }
-    std::cout << "Overall Bus Summary:\n";
-    std::cout << "Total Bus Transactions: " << total_bus_transactions << "\n";
-    std::cout << "Total Bus Traffic (Bytes): " << total_bus_traffic_bytes << "\n";
+    return 0;
 }
 
-// Utility: extract tag and set index from address
-uint32_t get_tag(uint32_t addr) {
-    return addr >> (b + s);
+void L1Cache::policy_touch(const CacheSet& set, int way) {
+    switch (policy) {
+    case ReplacementPolicy::PLRU: {
+        // Point every node on the way's path at the other half
+        int node = 1, first = 0, size = tree_leaves(set.ways);
+        while (size > 1) {
+            size /= 2;
+            uint64_t bit = uint64_t{1} << (node % 64);
+            if (way < first + size) {
+                set.plru[node / 64] |= bit;
+                node = 2 * node;
+            } else {
+                set.plru[node / 64] &= ~bit;
+                first += size;
+                node = 2 * node + 1;
+            }
+        }
+        break;
+    }
+    case ReplacementPolicy::SRRIP:
+    case ReplacementPolicy::BRRIP:
+        set.rrpv[way] = set.rrpv[way] & RRPV_FRESH ? set.rrpv[way] & ~RRPV_FRESH : 0;
+        break;
+    case ReplacementPolicy::LRU:
+    case ReplacementPolicy::RANDOM: break;
+    }
 }
-uint32_t get_set_index(uint32_t addr) {
-    return (addr >> b) & ((1 << s) - 1);
+
+void L1Cache::policy_inserted(const CacheSet& set, int way) {
+    switch (policy) {
+    case ReplacementPolicy::SRRIP: set.rrpv[way] = (RRPV_MAX - 1) | RRPV_FRESH; break;
+    case ReplacementPolicy::BRRIP:
+        // Mostly distant, so blocks streamed through once leave first; occasionally long
+        set.rrpv[way] = (brrip_fills++ % BRRIP_LONG_EVERY ? RRPV_MAX : RRPV_MAX - 1) | RRPV_FRESH;
+        break;
+    case ReplacementPolicy::RANDOM:
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 7;
+        random_state ^= random_state << 17;
+        break;
+    case ReplacementPolicy::LRU:
+    case ReplacementPolicy::PLRU: break;
+    }
 }
 
 // CacheController::process_memory_access implementation
-void CacheController::process_memory_access(int core_id, uint32_t addr, bool is_write, Bus& bus) {
+template <class G>
+bool CacheController::process_memory_access(int core_id, uint32_t addr, bool is_write, Bus& bus) {
     L1Cache& cache = l1_caches[core_id];
-    uint32_t tag = get_tag(addr);
-    uint32_t set_idx = get_set_index(addr);
-    auto& set = cache.sets[set_idx];
-    int idx = cache.find_line(set, tag);
+    uint32_t tag = get_tag<G>(addr);
+    uint32_t set_idx = get_set_index<G>(addr);
+    auto set = cache.set<G>(set_idx);
+    int idx = cache.find_line<G>(set, tag);
 
     // Hit
     if (idx != -1 && set[idx].mesi != MESIState::INVALID) {
         if (is_write) {
-            if (set[idx].mesi == MESIState::SHARED) {
+            if (needs_upgrade(set[idx].mesi)) {
                 if (bus.available) {
                     bus.src_core = core_id;
                     bus.addr = addr;
                     bus.req_type = BusRequestType::BUSUPGR;
                     bus.available = false;
+                    bus.prefetch = false;
 
                     cache.stats.bus_invalidations++;
                     total_bus_transactions++;
                 } else {
-                    if (core_id == bus.src_core) {
-                        cache.stats.total_cycles++;
-                    } else {
-                        cache.stats.idle_cycles++;
-                    }
-                    return;
+                    if (wait_for_bus(core_id, addr, bus)) bus.demanded = true;
+                    return false;
                 }
             }
-            // Write the value
-            set[idx].mesi = MESIState::MODIFIED;
-            set[idx].lru_counter = ++cache.global_lru_counter;
-            cache.stats.total_writes++;
-        } else {
-            // Read the value
-            set[idx].lru_counter = ++cache.global_lru_counter;
-            cache.stats.total_reads++;
         }
-        cache.stats.total_instructions++;
-        cache.stats.total_cycles++;
-        pc[core_id]++;
-        return;
+        if (set[idx].prefetched) prefetch_used(core_id, set_idx, set[idx]);
+        retire_hit(core_id, set, idx, is_write);
+        return true;
     }
 
     // Miss: need to handle MESI protocol and bus
@@ -125,20 +487,18 @@ void CacheController::process_memory_access(int core_id, uint32_t addr, bool is_
             bus.req_type = BusRequestType::BUSRDX;
             bus.available = false;
             bus.done = true;
+            bus.prefetch = false;
+            if (!prefetch_units.empty()) train_prefetcher(core_id, block_address(tag, set_idx));
 
             cache.stats.total_cycles++;
             cache.stats.cache_misses++;
             cache.stats.bus_invalidations++;
-            cache.stats.data_traffic_bytes += block_size;
+            cache.stats.data_traffic_bytes += config.block_size;
             total_bus_transactions++;
-            total_bus_traffic_bytes += block_size;
+            total_bus_traffic_bytes += config.block_size;
         } else {
-            if (core_id == bus.src_core) {
-                cache.stats.total_cycles++;
-            } else {
-                cache.stats.idle_cycles++;
-            }
-            return;
+            if (wait_for_bus(core_id, addr, bus)) bus.demanded = true;
+            return false;
         }
     } else {
         if (bus.available) {
@@ -147,65 +507,368 @@ void CacheController::process_memory_access(int core_id, uint32_t addr, bool is_
             bus.req_type = BusRequestType::BUSRD;
             bus.available = false;
             bus.done = true;
+            bus.prefetch = false;
+            if (!prefetch_units.empty()) train_prefetcher(core_id, block_address(tag, set_idx));
 
             cache.stats.total_cycles++;
             cache.stats.cache_misses++;
-            cache.stats.data_traffic_bytes += block_size;
+            cache.stats.data_traffic_bytes += config.block_size;
             total_bus_transactions++;
-            total_bus_traffic_bytes += block_size;
+            total_bus_traffic_bytes += config.block_size;
         } else {
-            if (core_id == bus.src_core) {
-                cache.stats.total_cycles++;
-            } else {
-                cache.stats.idle_cycles++;
-            }
-            return;
+            if (wait_for_bus(core_id, addr, bus)) bus.demanded = true;
+            return false;
+        }
+    }
+    return false;
+}
+
+void CacheController::retire_hit(int core_id, const CacheSet& set, int way, bool is_write, bool count_cycle) {
+    L1Cache& cache = l1_caches[core_id];
+    if (is_write) {
+        // Write the value
+        set.states[way] = MESIState::MODIFIED;
+        cache.touch(set, way);
+        cache.stats.total_writes++;
+    } else {
+        // Read the value
+        cache.touch(set, way);
+        cache.stats.total_reads++;
+    }
+    cache.stats.total_instructions++;
+    if (count_cycle) cache.stats.total_cycles++;
+}
+
+template <class G>
+bool CacheController::try_private_hit(int core_id, uint32_t addr, bool is_write, bool count_cycle) {
+    L1Cache& cache = l1_caches[core_id];
+    auto set = cache.set<G>(get_set_index<G>(addr));
+    int idx = cache.find_line<G>(set, get_tag<G>(addr));
+    if (idx == -1 || set[idx].mesi == MESIState::INVALID) return false;
+    if (is_write && needs_upgrade(set[idx].mesi)) return false;
+    if (set[idx].prefetched) prefetch_used(core_id, get_set_index<G>(addr), set[idx]);
+    retire_hit(core_id, set, idx, is_write, count_cycle);
+    return true;
+}
+
+template <class G>
+bool CacheController::is_private_hit(int core_id, uint32_t addr, bool is_write) const {
+    const L1Cache& cache = l1_caches[core_id];
+    const auto set = cache.set<G>(get_set_index<G>(addr));
+    int idx = cache.find_line<G>(set, get_tag<G>(addr));
+    if (idx == -1 || set[idx].mesi == MESIState::INVALID || set[idx].prefetched) return false;
+    return !is_write || !needs_upgrade(set[idx].mesi);
+}
+
+uint32_t CacheController::block_address(uint32_t tag, uint32_t set_idx) const {
+    return (tag << config.s) | set_idx;
+}
+
+void CacheController::fill_line(int core, uint32_t set_idx, const CacheSet& set, int way, uint32_t tag,
+                                MESIState state) {
+    CacheLineRef line = set[way];
+    if (line.prefetched) {
+        l1_caches[core].stats.prefetch_useless++;
+        line.prefetched = 0;
+    }
+    if (llc.enabled()) {
+        // May take the line's old block out of this cache too, so it goes before the filter update
+        LLCEviction victim;
+        llc.filled(block_address(tag, set_idx), victim);
+        back_invalidate(victim);
+    }
+    if (config.snoop_filter) {
+        if (line.mesi != MESIState::INVALID) remove_holder(block_address(line.tag, set_idx), core);
+        add_holder(block_address(tag, set_idx), core);
+    }
+    line.mesi = state;
+    line.tag = tag;
+    l1_caches[core].inserted(set, way);
+}
+
+void CacheController::invalidate_line(int core, uint32_t set_idx, const CacheSet& set, int way) {
+    CacheLineRef line = set[way];
+    if (line.prefetched) {
+        l1_caches[core].stats.prefetch_useless++;
+        line.prefetched = 0;
+    }
+    if (config.snoop_filter) remove_holder(block_address(line.tag, set_idx), core);
+    line.mesi = MESIState::INVALID;
+    l1_caches[core].invalidated(set, way);
+}
+
+void CacheController::add_holder(uint32_t block, int core) {
+    if (llc.is_directory()) {
+        llc.add_holder(block, core);
+    } else {
+        snoop_filter.add(block, core);
+    }
+}
+
+void CacheController::remove_holder(uint32_t block, int core) {
+    if (llc.is_directory()) {
+        llc.remove_holder(block, core);
+    } else {
+        snoop_filter.remove(block, core);
+    }
+}
+
+bool CacheController::find_holders(uint32_t block, uint64_t* out) const {
+    return llc.is_directory() ? llc.holders(block, out) : snoop_filter.holders(block, out);
+}
+
+uint64_t CacheController::llc_read(uint32_t block, uint64_t now) {
+    LLCEviction victim;
+    uint64_t cycles = llc.read(block, now, victim);
+    back_invalidate(victim);
+    return cycles;
+}
+
+uint64_t CacheController::llc_write_back(uint32_t block, bool dropped, uint64_t now) {
+    LLCEviction victim;
+    uint64_t cycles = llc.write_back(block, dropped, now, victim);
+    back_invalidate(victim);
+    return cycles;
+}
+
+// An L1 evicted block: dirty data is written back, a clean copy only matters to an exclusive LLC
+void CacheController::llc_evicted(uint32_t block, bool dirty, uint64_t now) {
+    if (dirty) {
+        llc_write_back(block, true, now);
+        return;
+    }
+    LLCEviction victim;
+    llc.clean_eviction(block, victim);
+    back_invalidate(victim);
+}
+
+// Removes the block an inclusive LLC evicted from every L1; modified copies go to memory
+void CacheController::back_invalidate(const LLCEviction& victim) {
+    if (!victim.valid || config.llc_policy != InclusionPolicy::INCLUSIVE) return;
+    uint32_t set_idx = victim.block & ((1u << config.s) - 1);
+    uint32_t tag = victim.block >> config.s;
+    // Own copy of the holders: this can run inside a for_each_holder visit
+    std::vector<uint64_t> holders = victim.holders;
+    if (!llc.is_directory()) {
+        holders.assign((config.num_cores + 63) / 64, 0);
+        if (config.snoop_filter) {
+            snoop_filter.holders(victim.block, holders.data());
+        } else {
+            for (int core = 0; core < config.num_cores; ++core) holders[core / 64] |= uint64_t{1} << (core % 64);
+        }
+    }
+    for (size_t w = 0; w < holders.size(); ++w) {
+        for (uint64_t word = holders[w]; word; word &= word - 1) {
+            int core = static_cast<int>(w * 64 + __builtin_ctzll(word));
+            auto set = l1_caches[core].set(set_idx);
+            int idx = l1_caches[core].find_line(set, tag);
+            if (idx == -1 || set[idx].mesi == MESIState::INVALID) continue;
+            llc.back_invalidated(victim.block, is_dirty(set[idx].mesi));
+            invalidate_line(core, set_idx, set, idx);
+        }
+    }
+}
+
+bool CacheController::wait_for_bus(int core_id, uint32_t addr, const Bus& bus, uint64_t cycles) {
+    CacheStats& stats = l1_caches[core_id].stats;
+    if (bus.prefetch) {
+        // A prefetch is no core's access; report if it brings the block this core now waits for
+        stats.idle_cycles += cycles;
+        return core_id == bus.src_core && bus.req_type == BusRequestType::BUSRD &&
+               (addr >> config.b) == (bus.addr >> config.b);
+    }
+    if (core_id == bus.src_core) {
+        stats.total_cycles += cycles;
+    } else {
+        stats.idle_cycles += cycles;
+    }
+    return false;
+}
+
+bool CacheController::prefetch_pending() const {
+    for (const PrefetchUnit& unit : prefetch_units) {
+        if (!unit.queue.empty()) return true;
+    }
+    return false;
+}
+
+bool CacheController::issue_prefetch(Bus& bus) {
+    for (int core = 0; core < config.num_cores; ++core) {
+        std::deque<uint32_t>& queue = prefetch_units[core].queue;
+        while (!queue.empty()) {
+            uint32_t addr = queue.front() << config.b;
+            queue.pop_front();
+            auto set = l1_caches[core].set(get_set_index(addr));
+            int idx = l1_caches[core].find_line(set, get_tag(addr));
+            if (idx != -1 && set[idx].mesi != MESIState::INVALID) continue;
+
+            // A read like a demand miss: other copies are downgraded, a modified one written back
+            bus.src_core = core;
+            bus.addr = addr;
+            bus.req_type = BusRequestType::BUSRD;
+            bus.available = false;
+            bus.done = true;
+            bus.prefetch = true;
+            bus.demanded = false;
+            l1_caches[core].stats.prefetches++;
+            l1_caches[core].stats.prefetch_traffic_bytes += config.block_size;
+            total_bus_transactions++;
+            total_bus_traffic_bytes += config.block_size;
+            return true;
+        }
+    }
+    return false;
+}
+
+void CacheController::train_prefetcher(int core, uint32_t block) {
+    PrefetchUnit& unit = prefetch_units[core];
+    unit.scratch.clear();
+    unit.prefetcher->train(block, unit.scratch);
+    const uint32_t last_block = UINT32_MAX >> config.b;
+    for (uint32_t next : unit.scratch) {
+        if (next > last_block || unit.queue.size() >= PrefetchUnit::QUEUE_DEPTH) continue;
+        uint32_t addr = next << config.b;
+        auto set = l1_caches[core].set(get_set_index(addr));
+        int idx = l1_caches[core].find_line(set, get_tag(addr));
+        if (idx != -1 && set[idx].mesi != MESIState::INVALID) continue;
+        if (std::find(unit.queue.begin(), unit.queue.end(), next) != unit.queue.end()) continue;
+        unit.queue.push_back(next);
+    }
+}
+
+void CacheController::prefetch_used(int core, uint32_t set_idx, CacheLineRef line) {
+    line.prefetched = 0;
+    l1_caches[core].stats.prefetch_useful++;
+    train_prefetcher(core, block_address(line.tag, set_idx));
+}
+
+void CacheController::prefetch_filled(CacheLineRef line, Bus& bus) {
+    if (!bus.demanded) {
+        line.prefetched = 1;
+        return;
+    }
+    // Late: the core has been waiting for this block, which it now uses like a demand fill
+    l1_caches[bus.src_core].stats.prefetch_late++;
+    train_prefetcher(bus.src_core, bus.addr >> config.b);
+}
+
+MESIState CacheController::read_snooped_state(MESIState state) const {
+    if (config.protocol == Protocol::MOESI && is_dirty(state)) return MESIState::OWNED;
+    return MESIState::SHARED;
+}
+
+MESIState CacheController::shared_fill_state() const {
+    // MESIF: the newest copy becomes the forwarder
+    return config.protocol == Protocol::MESIF ? MESIState::FORWARD : MESIState::SHARED;
+}
+
+// The holder in M, O, E or F state (at most one exists), or for MOESI without one the
+// lowest-numbered sharer; MESIF never has a Shared copy answer
+int CacheController::read_responder(uint32_t block, uint32_t set_idx, uint32_t tag, int requester) {
+    int owner = -1, sharer = -1;
+    for_each_holder(block, [&](int core) {
+        if (core == requester) return;
+        auto set = l1_caches[core].set(set_idx);
+        int idx = l1_caches[core].find_line(set, tag);
+        if (idx == -1 || set[idx].mesi == MESIState::INVALID) return;
+        if (set[idx].mesi != MESIState::SHARED) {
+            owner = core;
+        } else if (sharer == -1) {
+            sharer = core;
+        }
+    });
+    return owner == -1 && config.protocol == Protocol::MOESI ? sharer : owner;
+}
+
+// Calls visit(core) in increasing core order for every core that may hold block:
+// all cores, or only the snoop filter's (or LLC directory's) holders when it is enabled
+template <typename Visit>
+void CacheController::for_each_holder(uint32_t block, Visit&& visit) {
+    if (!config.snoop_filter) {
+        for (int core = 0; core < config.num_cores; ++core) visit(core);
+        return;
+    }
+    if (!find_holders(block, holder_scratch.data())) return;
+    for (int w = 0; w < snoop_filter.words(); ++w) {
+        for (uint64_t word = holder_scratch[w]; word; word &= word - 1) {
+            visit(w * 64 + __builtin_ctzll(word));
         }
     }
 }
 
+// Counts a filter lookup made for a request from src_core
+void CacheController::count_filter_lookup(int src_core, uint32_t block) {
+    int others = 0;
+    if (find_holders(block, holder_scratch.data())) {
+        for (int w = 0; w < snoop_filter.words(); ++w) others += __builtin_popcountll(holder_scratch[w]);
+        if (holder_scratch[src_core / 64] >> (src_core % 64) & 1) others--;
+    }
+    snoop_filter.stats.lookups++;
+    if (others > 0) {
+        snoop_filter.stats.hits++;
+    } else {
+        snoop_filter.stats.misses++;
+    }
+    snoop_filter.stats.probes_avoided += config.num_cores - 1 - others;
+}
+
 // MESI snoop: update other caches on bus transaction
-void CacheController::mesi_snoop(Bus& bus) {
+void CacheController::mesi_snoop(Bus& bus, uint64_t now) {
     if (bus.available) return;
     bool cache_responded = false;
+    uint64_t flush_cycles = config.memory_cycles;
 
     uint32_t tag = get_tag(bus.addr);
     uint32_t set_idx = get_set_index(bus.addr);
-    std::vector<int> sharers;
-    if (bus.req_type == BusRequestType::BUSRD || bus.req_type == BusRequestType::BUSRDX) {
-        auto& src_set = l1_caches[bus.src_core].sets[set_idx];
-        int src_idx = l1_caches[bus.src_core].find_lru(src_set);
+    uint32_t block = block_address(tag, set_idx);
+    int sharer_count = 0;
+    int sharer = -1;
+    // A new read makes room for its block (later snoops of the same transaction find the
+    // victim way already invalid)
+    if ((bus.req_type == BusRequestType::BUSRD || bus.req_type == BusRequestType::BUSRDX) && bus.done) {
+        auto src_set = l1_caches[bus.src_core].set(set_idx);
+        int src_idx = l1_caches[bus.src_core].choose_victim(src_set);
         if (src_set[src_idx].mesi != MESIState::INVALID) {
-            for (int core = 0; core < NUM_CORES; ++core) {
-                if (core == bus.src_core) continue;
-                auto& set = l1_caches[core].sets[set_idx];
+            for_each_holder(block, [&](int core) {
+                if (core == bus.src_core) return;
+                auto set = l1_caches[core].set(set_idx);
                 int idx = l1_caches[core].find_line(set, tag);
-                if (idx != -1 && set[idx].mesi == MESIState::SHARED) {
-                    sharers.push_back(core);
+                if (idx != -1 && needs_upgrade(set[idx].mesi)) {
+                    sharer = core;
+                    sharer_count++;
                 }
+            });
+            if (sharer_count == 1) {
+                auto set = l1_caches[sharer].set(set_idx);
+                int idx = l1_caches[sharer].find_line(set, tag);
+                // A lone Owned copy stays the owner of its dirty data
+                if (set[idx].mesi != MESIState::OWNED) set[idx].mesi = MESIState::EXCLUSIVE;
             }
-            if (sharers.size() == 1) {
-                auto& set = l1_caches[sharers[0]].sets[set_idx];
-                int idx = l1_caches[sharers[0]].find_line(set, tag);
-                set[idx].mesi = MESIState::EXCLUSIVE;
-            }
-            if (src_set[src_idx].mesi == MESIState::MODIFIED) {
+            if (is_dirty(src_set[src_idx].mesi)) {
                 bus.prev_req_type = bus.req_type;
                 bus.req_type = BusRequestType::FLUSH;
                 bus.evict = true;
                 l1_caches[bus.src_core].stats.writebacks++;
-                l1_caches[bus.src_core].stats.data_traffic_bytes += block_size;
+                l1_caches[bus.src_core].stats.data_traffic_bytes += config.block_size;
                 total_bus_transactions++;
-                total_bus_traffic_bytes += block_size;
+                total_bus_traffic_bytes += config.block_size;
             }
-            src_set[src_idx].mesi = MESIState::INVALID;
+            if (llc.enabled()) {
+                uint32_t victim = block_address(src_set[src_idx].tag, set_idx);
+                if (is_dirty(src_set[src_idx].mesi)) {
+                    flush_cycles = llc_write_back(victim, true, now);
+                } else {
+                    llc_evicted(victim, false, now);
+                }
+            }
+            invalidate_line(bus.src_core, set_idx, src_set, src_idx);
             l1_caches[bus.src_core].stats.cache_evictions++;
         }
     }
 
     if (bus.req_type == BusRequestType::FLUSH && bus.evict) {
         if (bus.done) {
-            bus.cycles_remaining = memory_cycles;
+            bus.cycles_remaining = flush_cycles;
             bus.resp_core = -1;
             bus.done = false;
         }
@@ -215,50 +878,70 @@ void CacheController::mesi_snoop(Bus& bus) {
         }
     }
 
-    // Iterating through each core
-    for (int core = 0; core < NUM_CORES; ++core) {
-        auto& set = l1_caches[core].sets[set_idx];
+    // Iterating through each core (or each holder, with the snoop filter)
+    // Only snoops that start or finish a bus phase count: mid-countdown snoops are skipped by
+    // the event engine, so they are left out to keep the counts engine-independent
+    if (config.snoop_filter && (bus.done || bus.cycles_remaining == 0)) count_filter_lookup(bus.src_core, block);
+    // MOESI and MESIF: a read is answered by one designated cache
+    int designated = -1;
+    if (config.protocol != Protocol::MESI && bus.req_type == BusRequestType::BUSRD && bus.done) {
+        designated = read_responder(block, set_idx, tag, bus.src_core);
+    }
+    bool other_copies = false; // MESIF: Shared copies stay while memory answers the read
+    for_each_holder(block, [&](int core) {
+        auto set = l1_caches[core].set(set_idx);
         int idx = l1_caches[core].find_line(set, tag);
 
-        if (core == bus.src_core) continue;
-        if (idx == -1) continue;
-        if (set[idx].mesi == MESIState::INVALID) continue;
+        if (core == bus.src_core) return;
+        if (idx == -1) return;
+        if (set[idx].mesi == MESIState::INVALID) return;
 
         if (bus.req_type == BusRequestType::BUSRD) {
+            if (config.protocol != Protocol::MESI && core != (bus.done ? designated : bus.resp_core)) {
+                if (config.protocol == Protocol::MOESI) {
+                    cache_responded = true;
+                } else {
+                    other_copies = true;
+                }
+                return;
+            }
             if (bus.done) {
-                bus.cycles_remaining = bus_cycles;
+                if (profiler && set[idx].mesi == MESIState::MODIFIED) profiler->downgraded(block, bus.src_core, core);
+                bus.cycles_remaining = config.bus_cycles;
                 bus.resp_core = core;
                 bus.done = false;
                 bus.prev_mesi_state = set[idx].mesi;
-                set[idx].mesi = MESIState::SHARED;
+                set[idx].mesi = read_snooped_state(set[idx].mesi);
             }
             if (core == bus.resp_core && !bus.cycles_remaining) {
                 bus.available = true;
                 bus.done = true;
-                set[idx].lru_counter = ++l1_caches[core].global_lru_counter;
-                l1_caches[core].stats.data_traffic_bytes += block_size;
+                l1_caches[core].touch(set, idx);
+                l1_caches[core].stats.data_traffic_bytes += config.block_size;
 
-                auto& set = l1_caches[bus.src_core].sets[set_idx];
-                int idx = l1_caches[bus.src_core].find_lru(set);
-                set[idx].mesi = MESIState::SHARED;
-                set[idx].tag = tag;
+                auto set = l1_caches[bus.src_core].set(set_idx);
+                int idx = l1_caches[bus.src_core].choose_victim(set);
+                fill_line(bus.src_core, set_idx, set, idx, tag, shared_fill_state());
+                if (bus.prefetch) prefetch_filled(set[idx], bus);
 
-                if (bus.prev_mesi_state == MESIState::MODIFIED) {
+                // MOESI keeps the data dirty in the Owned copy instead of writing it back
+                if (bus.prev_mesi_state == MESIState::MODIFIED && config.protocol != Protocol::MOESI) {
                     bus.prev_req_type = bus.req_type;
                     bus.src_core = core;
                     bus.req_type = BusRequestType::FLUSH;
                     bus.available = false;
                     bus.evict = false;
                     l1_caches[core].stats.writebacks++;
-                    l1_caches[core].stats.data_traffic_bytes += block_size;
+                    l1_caches[core].stats.data_traffic_bytes += config.block_size;
                     total_bus_transactions++;
-                    total_bus_traffic_bytes += block_size;
+                    total_bus_traffic_bytes += config.block_size;
                 }
             }
             cache_responded = true;
         }
         if (bus.req_type == BusRequestType::BUSRDX) {
-            if (set[idx].mesi == MESIState::MODIFIED) {
+            if (profiler) profiler->invalidated(block, bus.src_core, core, is_dirty(set[idx].mesi));
+            if (is_dirty(set[idx].mesi)) {
                 bus.prev_core = bus.src_core;
                 bus.prev_req_type = bus.req_type;
                 bus.src_core = core;
@@ -267,18 +950,19 @@ void CacheController::mesi_snoop(Bus& bus) {
                 l1_caches[bus.prev_core].stats.total_cycles--;
                 l1_caches[bus.prev_core].stats.idle_cycles++;
                 l1_caches[core].stats.writebacks++;
-                l1_caches[core].stats.data_traffic_bytes += block_size;
+                l1_caches[core].stats.data_traffic_bytes += config.block_size;
                 total_bus_transactions++;
-                total_bus_traffic_bytes += block_size;
+                total_bus_traffic_bytes += config.block_size;
             }
-            set[idx].mesi = MESIState::INVALID;
+            invalidate_line(core, set_idx, set, idx);
         }
         if (bus.req_type == BusRequestType::BUSUPGR) {
-            if (set[idx].mesi == MESIState::SHARED) {
-                set[idx].mesi = MESIState::INVALID;
+            if (needs_upgrade(set[idx].mesi)) {
+                if (profiler) profiler->invalidated(block, bus.src_core, core, false);
+                invalidate_line(core, set_idx, set, idx);
             }
         }
-    }
+    });
 
     if (bus.req_type == BusRequestType::BUSUPGR) {
         bus.available = true;
@@ -287,7 +971,7 @@ void CacheController::mesi_snoop(Bus& bus) {
     // Memory response
     if (bus.req_type == BusRequestType::FLUSH && !bus.evict) {
         if (bus.done) {
-            bus.cycles_remaining = memory_cycles;
+            bus.cycles_remaining = llc.enabled() ? llc_write_back(block, false, now) : config.memory_cycles;
             bus.resp_core = -1;
             bus.done = false;
         }
@@ -304,7 +988,7 @@ void CacheController::mesi_snoop(Bus& bus) {
     }
     if ((bus.req_type == BusRequestType::BUSRD && !cache_responded) || bus.req_type == BusRequestType::BUSRDX) {
         if (bus.done) {
-            bus.cycles_remaining = memory_cycles;
+            bus.cycles_remaining = llc.enabled() ? llc_read(block, now) : config.memory_cycles;
             bus.resp_core = -1;
             bus.done = false;
         }
@@ -312,12 +996,695 @@ void CacheController::mesi_snoop(Bus& bus) {
             bus.available = true;
             bus.done = true;
 
-            auto& set = l1_caches[bus.src_core].sets[set_idx];
-            int idx = l1_caches[bus.src_core].find_lru(set);
-            set[idx].mesi = bus.req_type == BusRequestType::BUSRDX ? MESIState::MODIFIED : MESIState::EXCLUSIVE;
-            set[idx].tag = tag;
+            auto set = l1_caches[bus.src_core].set(set_idx);
+            int idx = l1_caches[bus.src_core].choose_victim(set);
+            fill_line(bus.src_core, set_idx, set, idx, tag,
+                      bus.req_type == BusRequestType::BUSRDX ? MESIState::MODIFIED
+                      : other_copies                         ? MESIState::FORWARD
+                                                             : MESIState::EXCLUSIVE);
+            if (bus.prefetch) prefetch_filled(set[idx], bus);
+        }
+    }
+}
+
+template <class G>
+void CacheController::functional_access(int core_id, uint32_t addr, bool is_write) {
+    L1Cache& cache = l1_caches[core_id];
+    uint32_t tag = get_tag<G>(addr);
+    uint32_t set_idx = get_set_index<G>(addr);
+    auto set = cache.set<G>(set_idx);
+    int idx = cache.find_line<G>(set, tag);
+    bool valid = idx != -1 && set[idx].mesi != MESIState::INVALID;
+
+    // A miss or an upgrade: the other copies end up shared (read) or invalid (write)
+    if (!valid || (is_write && needs_upgrade(set[idx].mesi))) {
+        bool shared = false;
+        for_each_holder(block_address(tag, set_idx), [&](int core) {
+            if (core == core_id) return;
+            auto other = l1_caches[core].set<G>(set_idx);
+            int other_idx = l1_caches[core].find_line<G>(other, tag);
+            if (other_idx == -1 || other[other_idx].mesi == MESIState::INVALID) return;
+            shared = true;
+            if (is_write) {
+                invalidate_line(core, set_idx, other, other_idx);
+            } else {
+                other[other_idx].mesi = read_snooped_state(other[other_idx].mesi);
+            }
+        });
+        if (!valid) {
+            idx = cache.choose_victim<G>(set);
+            fill_line(core_id, set_idx, set, idx, tag, shared ? shared_fill_state() : MESIState::EXCLUSIVE);
+        }
+    }
+    if (is_write) set[idx].mesi = MESIState::MODIFIED;
+    cache.touch(set, idx);
+}
+
+SplitGrant CacheController::split_grant(int core_id, uint32_t addr, bool is_write, uint64_t now) {
+    L1Cache& cache = l1_caches[core_id];
+    uint32_t tag = get_tag(addr);
+    uint32_t set_idx = get_set_index(addr);
+    uint32_t block = block_address(tag, set_idx);
+    auto set = cache.set(set_idx);
+    int idx = cache.find_line(set, tag);
+
+    // Decided now rather than when queued: another grant may have invalidated a shared copy
+    SplitGrant grant;
+    bool valid = idx != -1 && set[idx].mesi != MESIState::INVALID;
+    grant.type = valid ? BusRequestType::BUSUPGR : is_write ? BusRequestType::BUSRDX : BusRequestType::BUSRD;
+    grant.has_data = !valid;
+
+    if (config.snoop_filter) count_filter_lookup(core_id, block);
+    int supplier = -1;
+    bool shared_copies = false;
+    for_each_holder(block, [&](int core) {
+        if (core == core_id) return;
+        auto other = l1_caches[core].set(set_idx);
+        int other_idx = l1_caches[core].find_line(other, tag);
+        if (other_idx == -1 || other[other_idx].mesi == MESIState::INVALID) return;
+        const MESIState state = other[other_idx].mesi;
+        shared_copies = true;
+
+        // The M, O, E or F copy supplies the block if there is one; MESIF Shared copies never do
+        bool can_supply = config.protocol != Protocol::MESIF || state != MESIState::SHARED;
+        if (can_supply && (supplier == -1 || state != MESIState::SHARED)) supplier = core;
+        bool keeps_dirty = config.protocol == Protocol::MOESI && grant.type == BusRequestType::BUSRD;
+        if (is_dirty(state) && grant.type != BusRequestType::BUSUPGR && !keeps_dirty) {
+            // The dirty copy goes to the requester and memory in the same transfer
+            l1_caches[core].stats.writebacks++;
+            total_bus_transactions++;
+            total_bus_traffic_bytes += config.block_size;
+            if (llc.enabled()) llc_write_back(block, false, now);
+        }
+        if (profiler) {
+            if (grant.type != BusRequestType::BUSRD) {
+                profiler->invalidated(block, core_id, core, is_dirty(state));
+            } else if (state == MESIState::MODIFIED) {
+                profiler->downgraded(block, core_id, core);
+            }
+        }
+        if (grant.type == BusRequestType::BUSRD) {
+            other[other_idx].mesi = read_snooped_state(state);
+        } else {
+            invalidate_line(core, set_idx, other, other_idx);
+        }
+    });
+
+    total_bus_transactions++;
+    if (grant.type == BusRequestType::BUSUPGR) {
+        cache.stats.bus_invalidations++;
+        grant.fill_state = MESIState::MODIFIED;
+        grant.from_memory = false;
+        grant.latency = 0;
+        return grant;
+    }
+    cache.stats.cache_misses++;
+    cache.stats.data_traffic_bytes += config.block_size;
+    total_bus_traffic_bytes += config.block_size;
+    if (grant.type == BusRequestType::BUSRDX) cache.stats.bus_invalidations++;
+    grant.from_memory = supplier == -1;
+    grant.latency = 0;
+    if (grant.from_memory) {
+        // The lookup starts the cycle after the grant
+        grant.latency = llc.enabled() ? llc_read(block, now + 1) : config.memory_cycles;
+    } else {
+        l1_caches[supplier].stats.data_traffic_bytes += config.block_size;
+    }
+    grant.fill_state = grant.type == BusRequestType::BUSRDX ? MESIState::MODIFIED
+                       : !grant.from_memory                 ? shared_fill_state()
+                       : shared_copies                      ? MESIState::FORWARD
+                                                            : MESIState::EXCLUSIVE;
+    return grant;
+}
+
+bool CacheController::split_complete(int core_id, uint32_t addr, bool is_write, const SplitGrant& grant,
+                                     uint32_t& victim_addr, uint64_t now, uint32_t merged_loads) {
+    L1Cache& cache = l1_caches[core_id];
+    uint32_t tag = get_tag(addr);
+    uint32_t set_idx = get_set_index(addr);
+    auto set = cache.set(set_idx);
+    bool dirty_victim = false;
+    int idx;
+    if (grant.type == BusRequestType::BUSUPGR) {
+        idx = cache.find_line(set, tag);
+    } else {
+        idx = cache.choose_victim(set);
+        if (set[idx].mesi != MESIState::INVALID) {
+            cache.stats.cache_evictions++;
+            if (is_dirty(set[idx].mesi)) {
+                dirty_victim = true;
+                victim_addr = block_address(set[idx].tag, set_idx) << config.b;
+                cache.stats.writebacks++;
+                cache.stats.data_traffic_bytes += config.block_size;
+                total_bus_transactions++;
+                total_bus_traffic_bytes += config.block_size;
+            }
+            if (llc.enabled()) {
+                llc_evicted(block_address(set[idx].tag, set_idx), is_dirty(set[idx].mesi), now);
+            }
+        }
+    }
+    fill_line(core_id, set_idx, set, idx, tag, grant.fill_state);
+    // The core has been charged for the cycles it waited; the access itself takes none extra
+    retire_hit(core_id, set, idx, is_write, false);
+    for (uint32_t i = 0; i < merged_loads; ++i) retire_hit(core_id, set, idx, false, false);
+    return dirty_victim;
+}
+
+void CacheController::rebuild_snoop_filter() {
+    if (!config.snoop_filter) return;
+    snoop_filter = SnoopFilter(config.num_cores);
+    llc.clear_holders();
+    for (int core = 0; core < config.num_cores; ++core) {
+        const L1Cache& cache = l1_caches[core];
+        for (int set_idx = 0; set_idx < cache.S; ++set_idx) {
+            CacheSet set = cache.set(set_idx);
+            for (int way = 0; way < set.ways; ++way) {
+                if (set.states[way] != MESIState::INVALID) add_holder(block_address(set.tags[way], set_idx), core);
+            }
+        }
+    }
+}
+
+// Longest run of cycles the event engine retires at once while the bus is idle
+constexpr uint64_t RUN_AHEAD_LIMIT = 1 << 16;
+// Below this much per-core work (cycles x cores) a window is not worth handing to the pool
+constexpr uint64_t PARALLEL_MIN_WORK = 1 << 12;
+// Idle-bus scans are only split across the pool with at least this many active cores
+constexpr size_t PARALLEL_MIN_SCAN_CORES = 16;
+
+// Cores [first, last) of worker `worker` when the cores are split into contiguous blocks
+static void core_range(int num_cores, int workers, int worker, int& first, int& last) {
+    first = static_cast<int>(static_cast<int64_t>(num_cores) * worker / workers);
+    last = static_cast<int>(static_cast<int64_t>(num_cores) * (worker + 1) / workers);
+}
+
+// Length of the idle-bus window as seen by cores [first, last): the smallest number of
+// leading private hits over those cores, capped at limit. Cores that run out of trace
+// without needing the bus, or that are waiting on the split bus, do not limit the window.
+// The cores are scanned together to a bound that doubles each round, so a core with a long
+// run of hits is not read far past the point where another core needs the bus: the work
+// stays proportional to the window found, also when it is empty.
+template <class G>
+uint64_t Simulator::scan_private_hits(int first, int last, uint64_t limit) {
+    constexpr uint64_t FINISHED = UINT64_MAX;
+    for (int core = first; core < last; ++core) scan_hits[core] = 0;
+    uint64_t window = limit;
+    for (uint64_t bound = std::min<uint64_t>(1, limit); ; bound = std::min(limit, bound * 2)) {
+        for (int core = first; core < last && window > 0; ++core) {
+            CoreState& state = cores[core];
+            if (state.done || state.waiting || scan_hits[core] == FINISHED) continue;
+            TraceCursor& cursor = state.cursor;
+            const TraceEntry* entry = cursor.at(state.pc);
+            if (!entry) continue;
+            // Only look inside the current window: stream cursors cannot rewind
+            uint64_t avail = cursor.contiguous(state.pc);
+            uint64_t cap = std::min(bound, window);
+            uint64_t hits = scan_hits[core];
+            while (hits < cap && hits < avail &&
+                   controller.is_private_hit<G>(core, static_cast<uint32_t>(entry[hits].addr), entry[hits].op == 'W')) {
+                hits++;
+            }
+            if (hits == avail && cursor.window_is_last()) {
+                scan_hits[core] = FINISHED; // finishes without touching the bus
+                continue;
+            }
+            scan_hits[core] = hits;
+            if (hits < cap) window = hits;
+        }
+        // Every core either stopped, at most at the window, or scanned the whole bound
+        if (window < bound || bound == limit) return std::min(window, bound);
+    }
+}
+
+// Runs cores [first, last) through `window` cycles in which they cannot interact (cores
+// waiting on the split bus are left to the caller). Only touches those cores' caches and
+// state, so disjoint ranges can run concurrently.
+template <bool Instrumented, class G>
+Simulator::WindowResult Simulator::run_window(int first, int last, uint64_t window) {
+    WindowResult result;
+    for (int core = first; core < last; ++core) {
+        CoreState& state = cores[core];
+        if (state.done || state.waiting) continue;
+        for (uint64_t cycle = 0; cycle < window; ++cycle) {
+            const TraceEntry* entry = state.cursor.at(state.pc);
+            if (!entry) {
+                state.done = true;
+                result.finished++;
+                result.last_done = std::max(result.last_done, cycle + 1);
+                break;
+            }
+            if (controller.try_private_hit<G>(core, static_cast<uint32_t>(entry->addr), entry->op == 'W')) {
+                if (Instrumented) metrics->retired(core, global_cycle + cycle);
+                state.pc++;
+                continue;
+            }
+
+            // Waiting for the bus until the window closes
+            if (Instrumented) metrics->stalled(core, global_cycle + cycle);
+            if (controller.wait_for_bus(core, static_cast<uint32_t>(entry->addr), bus, window - cycle)) {
+                result.demanded = true;
+            }
+            break;
         }
     }
+    return result;
+}
+
+// Event engine: finds the next cycles in which the cores cannot interact and runs each core
+// through them on its own. That holds in two cases:
+//  - the bus is counting down an in-flight phase: for bus.cycles_remaining cycles both snoops
+//    are no-ops and the bus stays taken, so each core retires private hits until its first
+//    access that needs the bus and then waits out the rest of the window;
+//  - the bus is free: up to the first cycle in which some core's access needs the bus, every
+//    core only hits privately and the snoops have nothing to do.
+// Per-core results (including LRU order) match the stepper exactly. The parallel engine
+// splits both the scan and the window across the worker pool; the bus and snoops stay on
+// the calling thread between windows. Returns the number of cycles advanced (0 = take a
+// normal step).
+template <bool Instrumented, class G>
+uint64_t Simulator::run_ahead() {
+    // Windows end at checkpoints and, in instrumented runs, at every sample boundary
+    uint64_t limit = std::min(RUN_AHEAD_LIMIT, pause_cycle - global_cycle);
+    if (Instrumented) limit = std::min(limit, metrics->next_sample - global_cycle);
+    uint64_t window;
+    if (bus.available) {
+        // A queued prefetch takes the free bus in the next step
+        window = controller.prefetch_pending() ? 0 : idle_window<G>(limit);
+    } else if (!bus.done && bus.cycles_remaining > 0) {
+        window = std::min(bus.cycles_remaining, limit);
+    } else {
+        return 0;
+    }
+    if (window == 0) return 0;
+
+    WindowResult result = execute_window<Instrumented, G>(window);
+    // The stepper stops as soon as the last core finishes
+    uint64_t cycles = active_cores == 0 ? result.last_done : window;
+    if (Instrumented && !bus.available) metrics->bus_busy(cycles);
+    bus.cycles_remaining -= cycles;
+    global_cycle += cycles;
+    return cycles;
+}
+
+// Split bus counterpart of run_ahead: while no request is queued, nothing happens on the bus
+// before its next transfer starts or ends, so the cores with no request outstanding run
+// their private hits up to then and the others wait it out.
+template <bool Instrumented, class G>
+uint64_t Simulator::run_ahead_split() {
+    if (!split_bus->queue_empty()) return 0;
+    // A non-blocking core with misses or stores outstanding keeps working meanwhile
+    for (const MissHandler& handler : miss_handlers) {
+        if (!handler.idle()) return 0;
+    }
+    uint64_t next = split_bus->next_event();
+    next = std::min(next, pause_cycle);
+    if (Instrumented) next = std::min(next, metrics->next_sample);
+    uint64_t limit = next <= global_cycle ? 0 : std::min(RUN_AHEAD_LIMIT, next - global_cycle);
+    uint64_t window = limit ? idle_window<G>(limit) : 0;
+    if (window == 0) return 0;
+
+    WindowResult result = execute_window<Instrumented, G>(window);
+    uint64_t cycles = active_cores == 0 ? result.last_done : window;
+    for (int core = 0; core < config().num_cores; ++core) {
+        // With the queue empty every waiting core's request has been granted
+        if (cores[core].waiting) controller.l1_caches[core].stats.total_cycles += cycles;
+    }
+    global_cycle += cycles;
+    return cycles;
+}
+
+// Number of cycles every core not waiting on the bus can spend on private hits, at most limit
+template <class G>
+uint64_t Simulator::idle_window(uint64_t limit) {
+    const int num_cores = config().num_cores;
+    if (!pool || active_cores < PARALLEL_MIN_SCAN_CORES) return scan_private_hits<G>(0, num_cores, limit);
+    std::vector<uint64_t> partial(pool->size());
+    pool->run([&](int worker) {
+        int first, last;
+        core_range(num_cores, pool->size(), worker, first, last);
+        partial[worker] = scan_private_hits<G>(first, last, limit);
+    });
+    return *std::min_element(partial.begin(), partial.end());
+}
+
+// Runs all cores through the window, on the pool when it is worth it
+template <bool Instrumented, class G>
+Simulator::WindowResult Simulator::execute_window(uint64_t window) {
+    const int num_cores = config().num_cores;
+    WindowResult total;
+    if (pool && window * active_cores >= PARALLEL_MIN_WORK) {
+        std::vector<WindowResult> partial(pool->size());
+        pool->run([&](int worker) {
+            int first, last;
+            core_range(num_cores, pool->size(), worker, first, last);
+            partial[worker] = run_window<Instrumented, G>(first, last, window);
+        });
+        for (const WindowResult& part : partial) {
+            total.finished += part.finished;
+            total.last_done = std::max(total.last_done, part.last_done);
+            total.demanded = total.demanded || part.demanded;
+        }
+    } else {
+        total = run_window<Instrumented, G>(0, num_cores, window);
+    }
+    active_cores -= total.finished;
+    // Workers only read the bus; the demand they saw is recorded here, on the calling thread
+    if (total.demanded) bus.demanded = true;
+    return total;
+}
+
+// One cycle of the reference model: snoop, let every core issue one access, snoop again
+template <bool Instrumented, class G>
+void Simulator::step() {
+    controller.mesi_snoop(bus, global_cycle);
+
+    for (int core = 0; core < config().num_cores; ++core) {
+        CoreState& state = cores[core];
+        if (state.done) continue;
+        const TraceEntry* entry = state.cursor.at(state.pc);
+        if (!entry) {
+            state.done = true;
+            active_cores--;
+            continue;
+        }
+        bool is_write = (entry->op == 'W');
+
+        // Simulate access using the controller's MESI protocol logic
+        bool was_available = bus.available;
+        bool completed = controller.process_memory_access<G>(core, static_cast<uint32_t>(entry->addr), is_write, bus);
+        if (Instrumented) {
+            if (was_available && !bus.available) metrics->granted(core, global_cycle);
+            if (completed) {
+                metrics->retired(core, global_cycle);
+            } else {
+                metrics->stalled(core, global_cycle);
+            }
+        }
+        if (completed) state.pc++;
+    }
+    // Prefetches are the lowest priority: they only get a bus no access asked for this cycle
+    if (bus.available && !controller.prefetch_units.empty()) controller.issue_prefetch(bus);
+
+    controller.mesi_snoop(bus, global_cycle);
+    if (Instrumented && !bus.available) metrics->bus_busy(1);
+    bus.cycles_remaining = std::max(bus.cycles_remaining - 1, static_cast<uint64_t>(0));
+    global_cycle++;
+}
+
+// One cycle with the split-transaction bus: cores issue or wait, the data bus and address
+// bus each take their next transaction, then finished transactions complete their access
+template <bool Instrumented, class G>
+void Simulator::step_split() {
+    const uint64_t now = global_cycle;
+    for (int core = 0; core < config().num_cores; ++core) {
+        CoreState& state = cores[core];
+        if (state.done) continue;
+        CacheStats& stats = controller.l1_caches[core].stats;
+        if (state.waiting) {
+            // Queued cycles are idle; once granted the core's own transaction is in progress
+            if (split_bus->granted(core)) {
+                stats.total_cycles++;
+            } else {
+                stats.idle_cycles++;
+            }
+            continue;
+        }
+        const TraceEntry* entry = state.cursor.at(state.pc);
+        if (!entry) {
+            state.done = true;
+            active_cores--;
+            continue;
+        }
+        uint32_t addr = static_cast<uint32_t>(entry->addr);
+        bool is_write = (entry->op == 'W');
+        if (controller.try_private_hit<G>(core, addr, is_write)) {
+            if (Instrumented) metrics->retired(core, now);
+            state.pc++;
+            continue;
+        }
+        if (Instrumented) metrics->stalled(core, now);
+        split_bus->request(core, addr, is_write, now);
+        state.waiting = true;
+        stats.idle_cycles++;
+    }
+
+    split_bus->start_transfer(now);
+    SplitRequest req;
+    if (split_bus->arbitrate(now, req)) {
+        split_bus->issue(req, controller.split_grant(req.core, req.addr, req.is_write, now), now);
+        if (Instrumented) metrics->granted(req.core, now);
+    }
+
+    SplitTransaction t;
+    while (split_bus->pop_completed(now, t)) {
+        if (t.posted) continue;
+        CoreState& state = cores[t.core];
+        const TraceEntry* entry = state.cursor.at(state.pc);
+        uint32_t victim;
+        if (controller.split_complete(t.core, t.addr, entry->op == 'W', t.grant, victim, now)) {
+            split_bus->post_writeback(t.core, victim, now + 1);
+        }
+        if (Instrumented) metrics->retired(t.core, now);
+        state.pc++;
+        state.waiting = false;
+    }
+    global_cycle++;
+}
+
+// One cycle with non-blocking L1s on the split bus. A core stalls only when it runs out of
+// MSHRs or store buffer entries: misses go to the bus and the core carries on, stores wait
+// in the store buffer, which performs its oldest one per cycle. A granted transaction's
+// completion retires the miss and the loads merged into its MSHR.
+template <bool Instrumented, class G>
+void Simulator::step_nonblocking() {
+    const uint64_t now = global_cycle;
+    for (int core = 0; core < config().num_cores; ++core) {
+        CoreState& state = cores[core];
+        if (state.done) continue;
+        CacheStats& stats = controller.l1_caches[core].stats;
+        MissHandler& handler = miss_handlers[core];
+
+        // Drain the oldest buffered store unless its block is already being fetched
+        if (!handler.store_buffer.empty()) {
+            uint32_t addr = handler.store_buffer.front();
+            uint32_t block = addr >> config().b;
+            if (!handler.find(block)) {
+                if (controller.try_private_hit<G>(core, addr, true, false)) {
+                    handler.store_buffer.pop_front();
+                } else if (handler.mshr_free()) {
+                    handler.allocate(block, addr, true);
+                    split_bus->request(core, addr, true, now);
+                }
+            }
+        }
+
+        const TraceEntry* entry = state.cursor.at(state.pc);
+        if (!entry) {
+            if (handler.idle()) {
+                state.done = true;
+                active_cores--;
+            } else {
+                // Waiting for the last misses and stores, counted as the blocking core counts it
+                (split_bus->granted(core) ? stats.total_cycles : stats.idle_cycles)++;
+            }
+            continue;
+        }
+        uint32_t addr = static_cast<uint32_t>(entry->addr);
+        uint32_t block = addr >> config().b;
+        bool issued = true;
+        if (entry->op == 'W') {
+            // Stores stay in order behind older buffered ones
+            if (handler.store_buffer.empty() && controller.try_private_hit<G>(core, addr, true)) {
+                // Retired as a private hit
+            } else if (!handler.buffer_full()) {
+                handler.store_buffer.push_back(addr);
+                handler.stats.buffered_stores++;
+                stats.total_cycles++;
+            } else {
+                handler.stats.buffer_full_cycles++;
+                issued = false;
+            }
+        } else if (handler.forwards(addr)) {
+            handler.stats.forwarded_loads++;
+            stats.total_reads++;
+            stats.total_instructions++;
+            stats.total_cycles++;
+        } else if (controller.try_private_hit<G>(core, addr, false)) {
+            // Retired as a private hit
+        } else if (MissHandler::Entry* pending = handler.find(block)) {
+            if (pending->merged < MissHandler::MAX_MERGED) {
+                pending->merged++;
+                handler.stats.merged_misses++;
+                stats.total_cycles++;
+            } else {
+                handler.stats.mshr_full_cycles++;
+                issued = false;
+            }
+        } else if (handler.mshr_free()) {
+            handler.allocate(block, addr, false);
+            split_bus->request(core, addr, false, now);
+            stats.total_cycles++;
+        } else {
+            handler.stats.mshr_full_cycles++;
+            issued = false;
+        }
+        if (issued) {
+            if (Instrumented) metrics->retired(core, now);
+            state.pc++;
+        } else {
+            if (Instrumented) metrics->stalled(core, now);
+            (split_bus->granted(core) ? stats.total_cycles : stats.idle_cycles)++;
+        }
+    }
+    for (MissHandler& handler : miss_handlers) handler.tick();
+
+    split_bus->start_transfer(now);
+    SplitRequest req;
+    if (split_bus->arbitrate(now, req)) {
+        split_bus->issue(req, controller.split_grant(req.core, req.addr, req.is_write, now), now);
+        if (Instrumented) metrics->granted(req.core, now);
+    }
+
+    SplitTransaction t;
+    while (split_bus->pop_completed(now, t)) {
+        if (t.posted) continue;
+        MissHandler& handler = miss_handlers[t.core];
+        // The core's own fills may have evicted the block it was upgrading: fetch it again
+        if (t.grant.type == BusRequestType::BUSUPGR && !controller.is_private_hit<G>(t.core, t.addr, false)) {
+            split_bus->request(t.core, t.addr, true, now);
+            continue;
+        }
+        MissHandler::Entry done = handler.release(t.block);
+        uint32_t victim;
+        if (controller.split_complete(t.core, t.addr, done.write, t.grant, victim, now, done.merged)) {
+            split_bus->post_writeback(t.core, victim, now + 1);
+        }
+        if (done.write) handler.store_buffer.pop_front();
+    }
+    global_cycle++;
+}
+
+// The cycle loop, built once as is and once with the instrumentation hooks compiled in
+template <bool Instrumented, class G>
+void Simulator::run_loop() {
+    if (split_bus) {
+        while (active_cores > 0) {
+            if ((global_cycle >= pause_cycle || checkpoint_requested) && pause()) return;
+            if (Instrumented && global_cycle >= metrics->next_sample) metrics->sample(*this);
+            if (config().engine != Engine::STEP && run_ahead_split<Instrumented, G>()) continue;
+            if (config().mshrs) {
+                step_nonblocking<Instrumented, G>();
+            } else {
+                step_split<Instrumented, G>();
+            }
+        }
+    } else {
+        while (active_cores > 0) {
+            if ((global_cycle >= pause_cycle || checkpoint_requested) && pause()) return;
+            if (Instrumented && global_cycle >= metrics->next_sample) metrics->sample(*this);
+            if (config().engine != Engine::STEP && run_ahead<Instrumented, G>()) continue;
+            step<Instrumented, G>();
+        }
+    }
+    if (Instrumented) metrics->finish(*this);
+}
+
+// Next cycle at which the loop has to stop for a scheduled checkpoint or at stop_cycle
+void Simulator::schedule_pause() {
+    pause_cycle = stop_cycle;
+    if (config().checkpoint_file.empty()) return;
+    if (config().checkpoint_at > global_cycle) pause_cycle = std::min(pause_cycle, config().checkpoint_at);
+    if (config().checkpoint_every) {
+        uint64_t every = config().checkpoint_every;
+        pause_cycle = std::min(pause_cycle, (global_cycle / every + 1) * every);
+    }
+}
+
+// Writes a checkpoint of the state at the start of the current cycle. Returns true if the
+// run should stop here (also at stop_cycle, without a checkpoint).
+bool Simulator::pause() {
+    if (global_cycle >= stop_cycle) return true;
+    checkpoint_requested = 0;
+    if (!config().checkpoint_file.empty() && save_checkpoint(*this, config().checkpoint_file)) {
+        std::cerr << "Checkpoint written to " << config().checkpoint_file << " at cycle " << global_cycle << "\n";
+    }
+    bool stop = config().checkpoint_at != 0 && global_cycle == config().checkpoint_at;
+    schedule_pause();
+    if (stop) stopped_at_checkpoint = true;
+    return stop;
+}
+
+void Simulator::run() {
+    if (sampler) {
+        sampler->run(*this);
+    } else {
+        simulate();
+    }
+    if (profiler && !stopped_at_checkpoint) profiler->finish(cores);
+}
+
+void Simulator::simulate() {
+    schedule_pause();
+    if (metrics) metrics->begin(*this);
+    with_geometry(config().E, config().b, [&](auto geometry) {
+        using G = decltype(geometry);
+        if (metrics) {
+            run_loop<true, G>();
+        } else {
+            run_loop<false, G>();
+        }
+    });
+}
+
+uint64_t Simulator::run_functional(int core, size_t goal) {
+    uint64_t stores = 0;
+    with_geometry(config().E, config().b, [&](auto geometry) {
+        stores = functional_loop<decltype(geometry)>(core, goal);
+    });
+    return stores;
+}
+
+template <class G>
+uint64_t Simulator::functional_loop(int core, size_t goal) {
+    CoreState& state = cores[core];
+    uint64_t stores = 0;
+    const TraceEntry* entry;
+    for (; state.pc < goal && (entry = state.cursor.at(state.pc)); state.pc++) {
+        bool is_write = entry->op == 'W';
+        controller.functional_access<G>(core, static_cast<uint32_t>(entry->addr), is_write);
+        stores += is_write;
+    }
+    return stores;
+}
+
+Simulator::Simulator(const SimConfig& config, const std::vector<TraceSource*>& sources)
+    : controller(config), cores(config.num_cores), active_cores(config.num_cores) {
+    // With sampling the cores read their traces one phase at a time
+    if (config.sampling_period) sampler = std::make_unique<Sampler>(config, sources);
+    for (int i = 0; i < config.num_cores; ++i) {
+        cores[i].cursor = TraceCursor(sampler ? sampler->source(i) : sources[i]);
+    }
+    if (config.engine == Engine::PARALLEL) {
+        int threads = config.threads > 0 ? config.threads : static_cast<int>(std::thread::hardware_concurrency());
+        threads = std::max(1, std::min(threads, config.num_cores));
+        if (threads > 1) pool = std::make_unique<WorkerPool>(threads);
+    }
+    scan_hits.resize(config.num_cores);
+    if (config.split_bus) split_bus = std::make_unique<SplitBus>(config);
+    if (config.mshrs) miss_handlers.assign(config.num_cores, MissHandler(config.mshrs, config.store_buffer));
+    if (config.sample_interval) metrics = std::make_unique<Metrics>(config.num_cores, config.sample_interval);
+    if (config.sharing_top) {
+        profiler = std::make_unique<SharingProfiler>(config.num_cores, config.b, config.sharing_top);
+        controller.profiler = profiler.get();
+    }
+}
+
+Simulator::~Simulator() = default;
+
+static bool ends_with(const std::string& text, const char* suffix) {
+    size_t n = strlen(suffix);
+    return text.size() >= n && text.compare(text.size() - n, n, suffix) == 0;
 }
 
 int main(int argc, char* argv[]) {
@@ -334,52 +1701,298 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    bool t_set = false, s_set = false, E_set = false, b_set = false, o_set = false;
+    SimConfig base;
+    std::vector<int> s_values, E_values, b_values;
+    std::vector<ReplacementPolicy> replacements;
+    std::string outfilename;
+    bool t_set = false, o_set = false;
+    std::string convert_prefix;
+    bool streaming = false;
+    std::vector<std::pair<int, std::string>> stream_paths;
+    int threads = 0;
+    std::string metrics_file;
+    uint64_t sample_interval = 10000;
+    std::string restore_file;
+    bool mrc = false;
+    bool verbose = false;
 
     // Second pass: parse all other arguments robustly
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "-t") == 0) {
             if (i + 1 < argc && argv[i + 1][0] != '-') {
-                tracefile = argv[++i];
+                base.tracefile = argv[++i];
                 t_set = true;
             } else {
                 std::cerr << "Error: -t requires a value.\n";
                 print_help();
                 return 1;
             }
-        } else if (strcmp(argv[i], "-s") == 0) {
+        } else if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "-E") == 0 || strcmp(argv[i], "-b") == 0) {
+            std::vector<int>& values = argv[i][1] == 's' ? s_values : argv[i][1] == 'E' ? E_values : b_values;
+            if (i + 1 < argc && argv[i + 1][0] != '-' && parse_int_list(argv[i + 1], values)) {
+                ++i;
+            } else {
+                std::cerr << "Error: " << argv[i] << " requires a value, a list (4,5,6) or a range (4-8).\n";
+                print_help();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-o") == 0) {
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                outfilename = argv[++i];
+                o_set = true;
+            } else {
+                std::cerr << "Error: -o requires a value.\n";
+                print_help();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-n") == 0) {
             if (i + 1 < argc && argv[i + 1][0] != '-') {
-                s = atoi(argv[++i]);
-                s_set = true;
+                base.num_cores = atoi(argv[++i]);
+                if (base.num_cores < 1 || base.num_cores > MAX_CORES) {
+                    std::cerr << "Error: -n must be between 1 and " << MAX_CORES << ".\n";
+                    return 1;
+                }
             } else {
-                std::cerr << "Error: -s requires a value.\n";
+                std::cerr << "Error: -n requires a value.\n";
                 print_help();
                 return 1;
             }
-        } else if (strcmp(argv[i], "-E") == 0) {
+        } else if (strcmp(argv[i], "-j") == 0) {
             if (i + 1 < argc && argv[i + 1][0] != '-') {
-                E = atoi(argv[++i]);
-                E_set = true;
+                threads = atoi(argv[++i]);
+                base.threads = threads;
             } else {
-                std::cerr << "Error: -E requires a value.\n";
+                std::cerr << "Error: -j requires a value.\n";
                 print_help();
                 return 1;
             }
-        } else if (strcmp(argv[i], "-b") == 0) {
+        } else if (strcmp(argv[i], "-c") == 0) {
             if (i + 1 < argc && argv[i + 1][0] != '-') {
-                b = atoi(argv[++i]);
-                b_set = true;
+                convert_prefix = argv[++i];
             } else {
-                std::cerr << "Error: -b requires a value.\n";
+                std::cerr << "Error: -c requires a value.\n";
                 print_help();
                 return 1;
             }
-        } else if (strcmp(argv[i], "-o") == 0) {
+        } else if (strcmp(argv[i], "--engine") == 0) {
+            const char* name = i + 1 < argc ? argv[++i] : "";
+            if (strcmp(name, "step") == 0) {
+                base.engine = Engine::STEP;
+            } else if (strcmp(name, "event") == 0) {
+                base.engine = Engine::EVENT;
+            } else if (strcmp(name, "parallel") == 0) {
+                base.engine = Engine::PARALLEL;
+            } else {
+                std::cerr << "Error: --engine must be step, event or parallel.\n";
+                print_help();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--protocol") == 0) {
+            const char* name = i + 1 < argc ? argv[++i] : "";
+            if (strcmp(name, "mesi") == 0) {
+                base.protocol = Protocol::MESI;
+            } else if (strcmp(name, "moesi") == 0) {
+                base.protocol = Protocol::MOESI;
+            } else if (strcmp(name, "mesif") == 0) {
+                base.protocol = Protocol::MESIF;
+            } else {
+                std::cerr << "Error: --protocol must be mesi, moesi or mesif.\n";
+                print_help();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--snoop-filter") == 0) {
+            base.snoop_filter = true;
+        } else if (strcmp(argv[i], "--split-bus") == 0) {
+            base.split_bus = true;
+        } else if (strcmp(argv[i], "--outstanding") == 0) {
             if (i + 1 < argc && argv[i + 1][0] != '-') {
-                outfilename = argv[++i];
-                o_set = true;
+                base.bus_outstanding = atoi(argv[++i]);
+                if (base.bus_outstanding < 1) {
+                    std::cerr << "Error: --outstanding must be at least 1.\n";
+                    return 1;
+                }
             } else {
-                std::cerr << "Error: -o requires a value.\n";
+                std::cerr << "Error: --outstanding requires a value.\n";
+                print_help();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--mshrs") == 0 || strcmp(argv[i], "--store-buffer") == 0) {
+            bool mshrs = strcmp(argv[i], "--mshrs") == 0;
+            int limit = mshrs ? 32 : 64;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                int value = atoi(argv[++i]);
+                if (value < 1 || value > limit) {
+                    std::cerr << "Error: " << argv[i - 1] << " must be between 1 and " << limit << ".\n";
+                    return 1;
+                }
+                (mshrs ? base.mshrs : base.store_buffer) = value;
+            } else {
+                std::cerr << "Error: " << argv[i] << " requires a value.\n";
+                print_help();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--arbitration") == 0) {
+            const char* name = i + 1 < argc ? argv[++i] : "";
+            if (strcmp(name, "rr") == 0) {
+                base.arbitration = Arbitration::ROUND_ROBIN;
+            } else if (strcmp(name, "age") == 0) {
+                base.arbitration = Arbitration::AGE;
+            } else {
+                std::cerr << "Error: --arbitration must be rr or age.\n";
+                print_help();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--llc") == 0 || strcmp(argv[i], "--llc-ways") == 0 ||
+                   strcmp(argv[i], "--llc-banks") == 0 || strcmp(argv[i], "--llc-latency") == 0) {
+            if (i + 1 < argc && argv[i + 1][0] != '-' && atoll(argv[i + 1]) > 0) {
+                uint64_t value = strtoull(argv[i + 1], nullptr, 10);
+                if (strcmp(argv[i], "--llc") == 0) {
+                    base.llc_kb = value;
+                } else if (strcmp(argv[i], "--llc-ways") == 0) {
+                    base.llc_ways = static_cast<int>(value);
+                } else if (strcmp(argv[i], "--llc-banks") == 0) {
+                    base.llc_banks = static_cast<int>(value);
+                } else {
+                    base.llc_latency = value;
+                }
+                ++i;
+            } else {
+                std::cerr << "Error: " << argv[i] << " requires a positive value.\n";
+                print_help();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--llc-policy") == 0) {
+            const char* name = i + 1 < argc ? argv[++i] : "";
+            if (strcmp(name, "nine") == 0) {
+                base.llc_policy = InclusionPolicy::NINE;
+            } else if (strcmp(name, "inclusive") == 0) {
+                base.llc_policy = InclusionPolicy::INCLUSIVE;
+            } else if (strcmp(name, "exclusive") == 0) {
+                base.llc_policy = InclusionPolicy::EXCLUSIVE;
+            } else {
+                std::cerr << "Error: --llc-policy must be inclusive, exclusive or nine.\n";
+                print_help();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--replacement") == 0) {
+            std::string list = i + 1 < argc ? argv[++i] : "";
+            std::stringstream names(list);
+            std::string name;
+            bool valid = !list.empty();
+            while (valid && std::getline(names, name, ',')) {
+                if (name == "lru") {
+                    replacements.push_back(ReplacementPolicy::LRU);
+                } else if (name == "plru") {
+                    replacements.push_back(ReplacementPolicy::PLRU);
+                } else if (name == "srrip") {
+                    replacements.push_back(ReplacementPolicy::SRRIP);
+                } else if (name == "brrip") {
+                    replacements.push_back(ReplacementPolicy::BRRIP);
+                } else if (name == "random") {
+                    replacements.push_back(ReplacementPolicy::RANDOM);
+                } else {
+                    valid = false;
+                }
+            }
+            if (!valid) {
+                std::cerr << "Error: --replacement must be lru, plru, srrip, brrip or random, or a comma list of them.\n";
+                print_help();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--prefetch") == 0) {
+            const char* name = i + 1 < argc ? argv[++i] : "";
+            if (strcmp(name, "next-line") == 0) {
+                base.prefetch = PrefetchKind::NEXT_LINE;
+            } else if (strcmp(name, "stride") == 0) {
+                base.prefetch = PrefetchKind::STRIDE;
+            } else if (strcmp(name, "stream") == 0) {
+                base.prefetch = PrefetchKind::STREAM;
+            } else {
+                std::cerr << "Error: --prefetch must be next-line, stride or stream.\n";
+                print_help();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--prefetch-degree") == 0) {
+            if (i + 1 < argc && argv[i + 1][0] != '-' && atoi(argv[i + 1]) > 0 && atoi(argv[i + 1]) <= 16) {
+                base.prefetch_degree = atoi(argv[++i]);
+            } else {
+                std::cerr << "Error: --prefetch-degree requires a number of blocks from 1 to 16.\n";
+                print_help();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--metrics") == 0) {
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                metrics_file = argv[++i];
+            } else {
+                std::cerr << "Error: --metrics requires a file name.\n";
+                print_help();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--sample") == 0) {
+            if (i + 1 < argc && argv[i + 1][0] != '-' && atoll(argv[i + 1]) > 0) {
+                sample_interval = strtoull(argv[++i], nullptr, 10);
+            } else {
+                std::cerr << "Error: --sample requires a positive number of cycles.\n";
+                print_help();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--checkpoint") == 0 || strcmp(argv[i], "--restore") == 0) {
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                bool save = strcmp(argv[i], "--checkpoint") == 0;
+                (save ? base.checkpoint_file : restore_file) = argv[++i];
+            } else {
+                std::cerr << "Error: " << argv[i] << " requires a file name.\n";
+                print_help();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--checkpoint-at") == 0 || strcmp(argv[i], "--checkpoint-every") == 0) {
+            if (i + 1 < argc && argv[i + 1][0] != '-' && atoll(argv[i + 1]) > 0) {
+                bool at = strcmp(argv[i], "--checkpoint-at") == 0;
+                (at ? base.checkpoint_at : base.checkpoint_every) = strtoull(argv[++i], nullptr, 10);
+            } else {
+                std::cerr << "Error: " << argv[i] << " requires a positive number of cycles.\n";
+                print_help();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--sampling") == 0 || strcmp(argv[i], "--sampling-warmup") == 0 ||
+                   strcmp(argv[i], "--sampling-detail") == 0) {
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                uint64_t value = strtoull(argv[i + 1], nullptr, 10);
+                if (strcmp(argv[i], "--sampling") == 0) {
+                    base.sampling_period = value;
+                } else if (strcmp(argv[i], "--sampling-warmup") == 0) {
+                    base.sampling_warmup = value;
+                } else {
+                    base.sampling_detail = value;
+                }
+                ++i;
+            } else {
+                std::cerr << "Error: " << argv[i] << " requires a number of accesses.\n";
+                print_help();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--sharing") == 0) {
+            if (i + 1 < argc && argv[i + 1][0] != '-' && atoi(argv[i + 1]) > 0) {
+                base.sharing_top = atoi(argv[++i]);
+            } else {
+                std::cerr << "Error: --sharing requires a positive number of blocks.\n";
+                print_help();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            verbose = true;
+        } else if (strcmp(argv[i], "--mrc") == 0) {
+            mrc = true;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            streaming = true;
+        } else if (strcmp(argv[i], "-p") == 0) {
+            const char* eq = i + 1 < argc ? strchr(argv[i + 1], '=') : nullptr;
+            if (eq && eq != argv[i + 1] && eq[1] != '\0') {
+                int core = atoi(argv[++i]);
+                stream_paths.emplace_back(core, std::string(eq + 1));
+                streaming = true;
+            } else {
+                std::cerr << "Error: -p requires a value of the form <core>=<path>.\n";
                 print_help();
                 return 1;
             }
@@ -393,66 +2006,244 @@ int main(int argc, char* argv[]) {
             return 1;
         }
     }
+    const int num_cores = base.num_cores;
+    if (!metrics_file.empty()) base.sample_interval = sample_interval;
+
+    if (!convert_prefix.empty()) {
+        for (int i = 0; i < num_cores; ++i) {
+            if (!convert_trace(convert_prefix, i)) return 1;
+        }
+        return 0;
+    }
 
-    if (!(t_set && s_set && E_set && b_set && o_set)) {
+    if (!(t_set && !s_values.empty() && !E_values.empty() && !b_values.empty() && o_set)) {
         std::cerr << "Error: All arguments -t, -s, -E, -b, -o are required.\n";
         print_help();
         return 1;
     }
 
-    // Prepare trace file names for all cores
-    std::vector<std::string> tracefiles(NUM_CORES);
-    for (int i = 0; i < NUM_CORES; ++i) {
-        tracefiles[i] = tracefile + "_proc" + std::to_string(i) + ".trace";
+    // One configuration per combination of the -s/-E/-b values and replacement policies
+    if (replacements.empty()) replacements.push_back(base.replacement);
+    std::vector<SimConfig> configs;
+    for (int s : s_values) {
+        for (int E : E_values) {
+            for (int b : b_values) {
+                for (ReplacementPolicy replacement : replacements) {
+                    SimConfig config = base;
+                    config.s = s;
+                    config.E = E;
+                    config.b = b;
+                    config.replacement = replacement;
+                    config.finalize();
+                    configs.push_back(config);
+                }
+            }
+        }
     }
-
-    // Read traces
-    std::vector<std::vector<TraceEntry>> traces(NUM_CORES);
-    for (int i = 0; i < NUM_CORES; ++i) {
-        traces[i] = read_trace(tracefiles[i]);
+    for (const SimConfig& config : configs) {
+        if (!config.llc_kb) continue;
+        uint64_t sets = (config.llc_kb * 1024 >> config.b) / config.llc_ways;
+        auto pow2 = [](uint64_t x) { return x && !(x & (x - 1)); };
+        if (!pow2(config.llc_banks) || !pow2(sets) || sets < static_cast<uint64_t>(config.llc_banks) ||
+            sets > (uint64_t{1} << 30)) {
+            std::cerr << "Error: --llc-banks must be a power of two and the LLC (--llc KB / --llc-ways / block size) "
+                         "a power-of-two number of sets, at least one per bank.\n";
+            return 1;
+        }
+    }
+    // Miss-ratio curves cover every combination in one pass rather than one run each
+    bool sweep = !mrc && configs.size() > 1;
+    if (sweep && base.engine == Engine::PARALLEL) {
+        // A sweep already keeps every thread busy with whole configurations
+        for (SimConfig& config : configs) config.engine = Engine::EVENT;
+    }
+    if ((base.checkpoint_at || base.checkpoint_every) && base.checkpoint_file.empty()) {
+        std::cerr << "Error: --checkpoint-at and --checkpoint-every need --checkpoint <file>.\n";
+        return 1;
+    }
+    if (sweep && (!base.checkpoint_file.empty() || !restore_file.empty())) {
+        std::cerr << "Error: checkpoints record a single configuration, not a sweep.\n";
+        return 1;
+    }
+    if (sweep && !metrics_file.empty()) {
+        std::cerr << "Error: --metrics records a single configuration, not a sweep.\n";
+        return 1;
+    }
+    if (base.sampling_period) {
+        if (base.sampling_detail == 0 || base.sampling_warmup + base.sampling_detail > base.sampling_period) {
+            std::cerr << "Error: --sampling-detail must be positive and warm-up plus detail at most --sampling.\n";
+            return 1;
+        }
+        if (base.split_bus || base.llc_kb || base.prefetch != PrefetchKind::NONE || !metrics_file.empty() ||
+            !base.checkpoint_file.empty() || !restore_file.empty()) {
+            std::cerr << "Error: --sampling cannot be combined with --split-bus, --llc, --prefetch, --metrics or "
+                         "checkpoints.\n";
+            return 1;
+        }
+    }
+    if (mrc) {
+        for (int s : s_values) {
+            if (s < 0 || s > 20) {
+                std::cerr << "Error: --mrc takes -s values from 0 to 20.\n";
+                return 1;
+            }
+        }
+        auto [min_E, max_E] = std::minmax_element(E_values.begin(), E_values.end());
+        if (*min_E < 1 || *max_E > 4096) {
+            std::cerr << "Error: --mrc takes -E values from 1 to 4096.\n";
+            return 1;
+        }
+        if (base.sampling_period || !metrics_file.empty() || !base.checkpoint_file.empty() || !restore_file.empty()) {
+            std::cerr << "Error: --mrc cannot be combined with --sampling, --metrics or checkpoints.\n";
+            return 1;
+        }
+        if (replacements.size() > 1 || replacements[0] != ReplacementPolicy::LRU) {
+            std::cerr << "Error: --mrc models LRU replacement only.\n";
+            return 1;
+        }
+    }
+    if (base.mshrs && !base.split_bus) {
+        std::cerr << "Error: --mshrs needs --split-bus (the atomic bus serves one miss at a time).\n";
+        return 1;
+    }
+    if (base.prefetch != PrefetchKind::NONE && base.split_bus) {
+        std::cerr << "Error: --prefetch issues its prefetches on the atomic bus and cannot be combined with --split-bus.\n";
+        return 1;
+    }
+    if (base.sharing_top && (sweep || streaming || base.sampling_period)) {
+        // The byte offsets come from reading the traces again after the run
+        std::cerr << "Error: --sharing profiles a single, fully simulated configuration with loaded traces.\n";
+        return 1;
+    }
+    if (base.sharing_top && !restore_file.empty()) {
+        // Checkpoints do not hold the profiler's counts, so the profile would miss the cycles before it
+        std::cerr << "Error: --sharing profiles a whole run and cannot be combined with --restore.\n";
+        return 1;
+    }
+    if (sweep && streaming) {
+        std::cerr << "Error: a sweep over several configurations cannot stream its traces.\n";
+        return 1;
     }
 
-    // Set up controller and caches
-    CacheController controller(NUM_CORES, s, E, b);
-    bus_cycles = 2 * controller.l1_caches[0].B / 4; // Bus cycles based on block size
-    memory_cycles = 100; // Memory cycles for DRAM access
-    block_size = 1 << b; // Block size in bytes
-
-    Bus bus;
+    std::vector<std::string> core_paths(num_cores); // -p path per core, the last one given wins
+    for (const auto& [core, p] : stream_paths) {
+        if (core < 0 || core >= num_cores) {
+            std::cerr << "Error: -p core " << core << " is out of range.\n";
+            return 1;
+        }
+        core_paths[core] = p;
+    }
+    // Two readers on stdin would split one stream between them unpredictably
+    if (std::count(core_paths.begin(), core_paths.end(), "-") > 1) {
+        std::cerr << "Error: -p can give stdin (-) to only one core.\n";
+        return 1;
+    }
 
-    while (active_cores > 0) {
-        controller.mesi_snoop(bus);
+    // Load traces (binary traces are mapped in place, text traces are parsed, both on up to
+    // -j threads), or start a background reader per core when streaming
+    std::vector<std::unique_ptr<TraceSource>> traces(num_cores);
+    std::vector<TraceSource*> sources(num_cores);
+    if (streaming) {
+        for (int i = 0; i < num_cores; ++i) {
+            std::string path = text_trace_path(base.tracefile, i);
+            if (access(binary_trace_path(base.tracefile, i).c_str(), F_OK) == 0) path = binary_trace_path(base.tracefile, i);
+            if (!core_paths[i].empty()) path = core_paths[i];
+            auto stream = std::make_unique<StreamTrace>();
+            if (!stream->open(path, i)) return 1;
+            traces[i] = std::move(stream);
+        }
+    } else {
+        std::vector<std::unique_ptr<Trace>> loaded;
+        if (!load_traces(base.tracefile, num_cores, threads, loaded)) return 1;
+        for (int i = 0; i < num_cores; ++i) traces[i] = std::move(loaded[i]);
+    }
+    for (int i = 0; i < num_cores; ++i) sources[i] = traces[i].get();
+    // A streamed trace that hit a read or format error ended early: report nothing from it
+    auto trace_failed = [&]() {
+        return std::any_of(sources.begin(), sources.end(), [](const TraceSource* s) { return s->failed(); });
+    };
 
-        for (int core = 0; core < NUM_CORES; ++core) {
-            if (core_done[core]) continue;
-            if (pc[core] >= traces[core].size()) {
-                core_done[core] = true;
-                active_cores--;
-                continue;
+    if (mrc) {
+        // A pass per block size; the traces are read again for each
+        std::vector<MissRatioCurve> curves;
+        int max_E = *std::max_element(E_values.begin(), E_values.end());
+        for (int b : b_values) {
+            if (b != b_values.front() && streaming) {
+                std::cerr << "Error: streamed traces can only be analysed for one block size.\n";
+                return 1;
             }
-            const TraceEntry& entry = traces[core][pc[core]];
-            bool is_write = (entry.op == 'W');
+            std::vector<MissRatioCurve> pass = analyse_miss_ratios(sources, s_values, b, max_E);
+            curves.insert(curves.end(), pass.begin(), pass.end());
+        }
+        if (trace_failed()) return 1;
+        bool json = ends_with(outfilename, ".json");
+        std::ofstream fout(outfilename);
+        if (json) {
+            write_mrc_json(curves, E_values, std::cout);
+            write_mrc_json(curves, E_values, fout);
+        } else {
+            write_mrc_csv(curves, E_values, std::cout);
+            write_mrc_csv(curves, E_values, fout);
+        }
+        return 0;
+    }
+
+    if (verbose) {
+        for (const SimConfig& config : configs) {
+            std::cerr << "Way Scan Kernel (E=" << config.E << ", b=" << config.b << "): " << way_scan_kernel(config)
+                      << "\n";
+        }
+    }
 
-            // Simulate access using the controller's MESI protocol logic
-            controller.process_memory_access(core, entry.addr, is_write, bus);
+    if (sweep) {
+        std::vector<SweepResult> results = run_sweep(configs, sources, threads);
+        bool json = ends_with(outfilename, ".json");
+        std::ofstream fout(outfilename);
+        if (json) {
+            write_sweep_json(results, std::cout);
+            write_sweep_json(results, fout);
+        } else {
+            write_sweep_csv(results, std::cout);
+            write_sweep_csv(results, fout);
         }
-        
-        controller.mesi_snoop(bus);
-        bus.cycles_remaining = std::max(bus.cycles_remaining - 1, static_cast<uint64_t>(0));
-        // std::cout << pc[0] << " " << pc[1] << " " << pc[2] << " " << pc[3] << " " << "\n";
-        global_cycle++;
+        return 0;
+    }
+
+    Simulator sim(configs[0], sources);
+    if (!restore_file.empty() && !load_checkpoint(sim, restore_file)) return 1;
+    if (!base.checkpoint_file.empty()) install_checkpoint_signal();
+    sim.run();
+    if (trace_failed()) return 1;
+    if (sim.stopped_at_checkpoint) {
+        std::cout << "Stopped at cycle " << sim.global_cycle << " after writing " << base.checkpoint_file << "\n";
+        return 0;
     }
 
     // Output stats
-    print_stats(controller.l1_caches, controller.total_bus_transactions, controller.total_bus_traffic_bytes);
+    print_stats(sim, std::cout);
 
     // Optionally, write to output file
     if (!outfilename.empty()) {
         std::ofstream fout(outfilename);
-        std::streambuf* coutbuf = std::cout.rdbuf();
-        std::cout.rdbuf(fout.rdbuf());
-        print_stats(controller.l1_caches, controller.total_bus_transactions, controller.total_bus_traffic_bytes);
-        std::cout.rdbuf(coutbuf);
+        print_stats(sim, fout);
+    }
+
+    if (sim.metrics) {
+        const Metrics& metrics = *sim.metrics;
+        if (ends_with(metrics_file, ".json")) {
+            std::ofstream mout(metrics_file);
+            metrics.write_json(mout);
+        } else {
+            size_t dot = metrics_file.find_last_of('.');
+            size_t slash = metrics_file.find_last_of('/');
+            std::string stem = dot != std::string::npos && (slash == std::string::npos || dot > slash)
+                                   ? metrics_file.substr(0, dot)
+                                   : metrics_file;
+            std::ofstream mout(metrics_file);
+            metrics.write_samples_csv(mout);
+            std::ofstream hout(stem + "_hist.csv");
+            metrics.write_histograms_csv(hout);
+        }
     }
 
     return 0;
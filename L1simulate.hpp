@@ -5,39 +5,129 @@
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <vector>
 
-// 'inline' allows these variables to be defined in a header and included in multiple translation units without linker errors.
-inline std::string tracefile = "";
-inline std::string outfilename = "";
-inline int s = -1;
-inline int E = -1;
-inline int b = -1;
-inline uint64_t bus_cycles = 0;
-inline uint64_t memory_cycles = 0;
-inline uint64_t block_size = 0;
-
-// Number of processor cores (change this to scale the simulation)
-inline int NUM_CORES = 4;
-
-// Per-core data
-inline std::vector<size_t> pc(NUM_CORES, 0);
-inline std::vector<bool> core_done(NUM_CORES, false);
-inline std::vector<uint64_t> core_wait_until(NUM_CORES, 0);
-
-inline uint64_t global_cycle = 0;
-inline size_t active_cores = NUM_CORES;
-
-// MESI protocol states
-enum class MESIState { INVALID, EXCLUSIVE, SHARED, MODIFIED };
-
-// Cache line structure
-struct CacheLine {
-    uint32_t tag = 0;
-    MESIState mesi = MESIState::INVALID;
-    uint64_t lru_counter = 0;
+#include "cache_simd.hpp"
+#include "llc.hpp"
+#include "mshr.hpp"
+#include "prefetch.hpp"
+#include "snoop_filter.hpp"
+#include "trace.hpp"
+#include "worker_pool.hpp"
+
+class Metrics;
+class Sampler;
+class SharingProfiler;
+class SplitBus;
+
+inline constexpr int MAX_CORES = 4096;
+
+// Simulation engine: STEP advances global_cycle one tick at a time; EVENT produces the
+// same statistics but jumps over cycles in which no core or bus state can change and
+// retires runs of private cache hits in bulk; PARALLEL is EVENT with the per-core work of
+// each such window spread over a thread pool
+enum class Engine { STEP, EVENT, PARALLEL };
+
+// Coherence protocol: MESI, MOESI (dirty blocks are shared from an Owned copy without a
+// memory writeback) or MESIF (clean shared blocks are supplied by the one Forward copy)
+enum class Protocol : uint8_t { MESI, MOESI, MESIF };
+
+// L1 replacement policy: true LRU, tree pseudo-LRU, static or bimodal RRIP (2-bit
+// re-reference prediction values per line) or random
+enum class ReplacementPolicy : uint8_t { LRU, PLRU, SRRIP, BRRIP, RANDOM };
+
+const char* replacement_name(ReplacementPolicy policy);
+
+// Order in which the split-transaction bus grants queued requests
+enum class Arbitration { ROUND_ROBIN, AGE };
+
+// Parameters of one simulation. Each simulator instance holds its own copy, so several
+// configurations can run side by side on different threads.
+struct SimConfig {
+    std::string tracefile;
+    int s = -1;
+    int E = -1;
+    int b = -1;
+    int num_cores = 4;
+    Protocol protocol = Protocol::MESI;
+    ReplacementPolicy replacement = ReplacementPolicy::LRU;
+    uint64_t bus_cycles = 0;
+    uint64_t memory_cycles = 100; // Memory cycles for DRAM access
+    uint64_t block_size = 0;
+    Engine engine = Engine::EVENT;
+    int threads = 0; // PARALLEL engine workers (0 = one per hardware thread)
+    bool snoop_filter = false; // Keep an inclusive snoop filter so snoops visit only the caches holding the block
+    bool split_bus = false;    // Split-transaction bus instead of the atomic one
+    int bus_outstanding = 4;   // Split bus: transactions in flight at once
+    Arbitration arbitration = Arbitration::ROUND_ROBIN;
+    int mshrs = 0;             // Split bus: MSHRs per non-blocking L1 (0 = blocking L1s)
+    int store_buffer = 8;      // Non-blocking L1s: store buffer entries
+    uint64_t sample_interval = 0; // Cycles between metrics samples (0 = instrumentation off)
+    std::string checkpoint_file;  // Where checkpoints are written (empty = never)
+    uint64_t checkpoint_at = 0;   // Write a checkpoint at this cycle and stop (0 = no)
+    uint64_t checkpoint_every = 0; // Also write one every this many cycles and continue (0 = no)
+    uint64_t sampling_period = 0;     // Cycles from one measured window to the next (0 = no sampling)
+    uint64_t sampling_warmup = 20000; // Sampling: detailed but unmeasured cycles before each window
+    uint64_t sampling_detail = 10000; // Sampling: measured cycles per window
+    int sharing_top = 0;              // Blocks reported by the sharing profiler (0 = profiler off)
+    uint64_t llc_kb = 0;          // Shared LLC size in KB (0 = no LLC, misses go straight to memory)
+    int llc_ways = 16;
+    int llc_banks = 4;
+    uint64_t llc_latency = 20;    // Cycles per LLC access (bank occupancy)
+    InclusionPolicy llc_policy = InclusionPolicy::NINE;
+    PrefetchKind prefetch = PrefetchKind::NONE; // L1 prefetcher (atomic bus only)
+    int prefetch_degree = 2;                    // Blocks predicted per trained access
+
+    // Derives the block size and bus timing from s/E/b
+    void finalize() {
+        block_size = uint64_t{1} << b; // Block size in bytes
+        bus_cycles = 2 * block_size / 4; // Bus cycles based on block size
+    }
+};
+
+// Per-core simulation state, one contiguous entry per core
+struct CoreState {
+    TraceCursor cursor; // read position in this core's trace
+    size_t pc = 0;      // index of the next trace entry to execute
+    bool done = false;
+    bool waiting = false; // has a request queued or in flight on the split bus
+};
+
+// MESI protocol states, plus OWNED (MOESI) and FORWARD (MESIF)
+enum class MESIState : uint8_t { INVALID, EXCLUSIVE, SHARED, MODIFIED, OWNED, FORWARD };
+
+// Newer than memory, so evicting it needs a writeback
+inline bool is_dirty(MESIState state) {
+    return state == MESIState::MODIFIED || state == MESIState::OWNED;
+}
+// Valid but possibly held by other caches too, so a write needs a bus upgrade
+inline bool needs_upgrade(MESIState state) {
+    return state == MESIState::SHARED || state == MESIState::OWNED || state == MESIState::FORWARD;
+}
+
+// Reference to one line of a set; the fields live in separate arrays of the owning L1Cache
+struct CacheLineRef {
+    uint32_t& tag;
+    MESIState& mesi;
+    uint8_t& prefetched; // filled by a prefetch and not yet used by the core
+};
+
+// View of one set: ways [0, ways) of the cache's tag, state and prefetch arrays, and the
+// replacement state of its policy (the other policies' pointers are null)
+struct CacheSet {
+    uint32_t* tags;
+    MESIState* states;
+    uint64_t* ages;  // LRU: stamp of each way's last use
+    uint8_t* rrpv;   // SRRIP/BRRIP: re-reference prediction value of each way
+    uint64_t* plru;  // PLRU: the set's tree bits (node n is bit n, root 1)
+    uint64_t* valid; // all but LRU: bit per way, set while the way holds a block
+    uint8_t* prefetched;
+    int ways;
+
+    CacheLineRef operator[](int way) const { return {tags[way], states[way], prefetched[way]}; }
 };
 
 // Cache statistics structure
@@ -52,41 +142,143 @@ struct CacheStats {
     uint64_t writebacks = 0;
     uint64_t bus_invalidations = 0;
     uint64_t data_traffic_bytes = 0;
+    uint64_t prefetches = 0;             // prefetch transactions issued
+    uint64_t prefetch_useful = 0;        // prefetched blocks the core then used
+    uint64_t prefetch_late = 0;          // prefetches the core was already waiting for on arrival
+    uint64_t prefetch_useless = 0;       // prefetched blocks evicted or invalidated unused
+    uint64_t prefetch_traffic_bytes = 0; // bus data moved by prefetches
+};
+
+// Cache shape fixed at compile time for the specialised hot paths. Ways == 0 and
+// BlockBits == 0 leave that parameter to the runtime configuration (the generic path).
+template <int Ways, int BlockBits>
+struct Geometry {
+    static constexpr int WAYS = Ways;
+    static constexpr int BLOCK_BITS = BlockBits;
+    static constexpr int STRIDE = (Ways + CACHE_WAY_PAD - 1) / CACHE_WAY_PAD * CACHE_WAY_PAD;
 };
+using GenericGeometry = Geometry<0, 0>;
+
+// Calls visit(G{}) with the geometry whose specialised build handles E and b: E in
+// {1, 2, 4, 8, 16} and b in {5, 6}. Anything else (or a build with -DL1SIM_GENERIC) gets
+// GenericGeometry.
+template <int BlockBits, class Visit>
+void visit_ways(int E, Visit&& visit) {
+    switch (E) {
+    case 1: return visit(Geometry<1, BlockBits>{});
+    case 2: return visit(Geometry<2, BlockBits>{});
+    case 4: return visit(Geometry<4, BlockBits>{});
+    case 8: return visit(Geometry<8, BlockBits>{});
+    case 16: return visit(Geometry<16, BlockBits>{});
+    default: return visit(GenericGeometry{});
+    }
+}
+
+template <class Visit>
+void with_geometry(int E, int b, Visit&& visit) {
+#ifndef L1SIM_GENERIC
+    switch (b) {
+    case 5: return visit_ways<5>(E, visit);
+    case 6: return visit_ways<6>(E, visit);
+    }
+#endif
+    visit(GenericGeometry{});
+}
 
 // L1 Cache structure for a single core
 struct L1Cache {
     int S; // Number of sets
     int E; // Associativity
     int B; // Block size in bytes
+    int stride; // Ways per set rounded up to CACHE_WAY_PAD
+    ReplacementPolicy policy;
+    int plru_words; // PLRU: tree words per set
+    int valid_words; // all but LRU: valid-way mask words per set
     uint64_t global_lru_counter = 0; // For LRU tracking
-
-    // 2D vector: sets[set_idx][line_idx]
-    std::vector<std::vector<CacheLine>> sets;
+    uint64_t random_state = RANDOM_SEED; // RANDOM: xorshift state, advanced on every fill
+    uint64_t brrip_fills = 0;            // BRRIP: fills so far (every BRRIP_LONG_EVERY-th is inserted long)
 
     CacheStats stats;
 
-    L1Cache(int s_bits, int E, int b_bits)
-        : S(1 << s_bits), E(E), B(1 << b_bits), sets(S, std::vector<CacheLine>(E, CacheLine())) {}
+    L1Cache(int s_bits, int E, int b_bits, ReplacementPolicy policy = ReplacementPolicy::LRU);
+    L1Cache(const L1Cache& other);
+    L1Cache& operator=(const L1Cache& other);
+    ~L1Cache();
+
+    template <class G = GenericGeometry>
+    CacheSet set(uint32_t set_idx) const {
+        size_t base = static_cast<size_t>(set_idx) * (G::WAYS ? G::STRIDE : stride);
+        return {tags + base,
+                states + base,
+                ages ? ages + base : nullptr,
+                rrpv ? rrpv + base : nullptr,
+                plru ? plru + static_cast<size_t>(set_idx) * plru_words : nullptr,
+                valid ? valid + static_cast<size_t>(set_idx) * valid_words : nullptr,
+                prefetched + base,
+                G::WAYS ? G::WAYS : E};
+    }
 
-    int find_line(const std::vector<CacheLine>& set, uint32_t tag) const {
-        for (size_t i = 0; i < set.size(); ++i) {
-            if (set[i].tag == tag) return static_cast<int>(i);
+    template <class G = GenericGeometry>
+    int find_line(const CacheSet& set, uint32_t tag) const {
+        if constexpr (G::WAYS > 0) {
+            return find_tag_fixed<G::WAYS>(set.tags, tag);
+        } else {
+            return find_tag(set.tags, set.ways, tag);
+        }
+    }
+    // Way a fill of the set replaces: the first invalid way, otherwise the policy's choice.
+    // Calling it again before the fill returns the same way (RRIP ages the set only once).
+    template <class G = GenericGeometry>
+    int choose_victim(const CacheSet& set) {
+        if (policy != ReplacementPolicy::LRU) return policy_victim(set);
+        const uint8_t* states_raw = reinterpret_cast<const uint8_t*>(set.states);
+        if constexpr (G::WAYS > 0) {
+            return find_victim_fixed<G::WAYS>(states_raw, set.ages);
+        } else {
+            return find_victim(states_raw, set.ages, set.ways);
         }
-        return -1;
     }
-    int find_lru(const std::vector<CacheLine>& set) const {
-        uint64_t min_lru = UINT64_MAX;
-        int lru_idx = 0;
-        for (size_t i = 0; i < set.size(); ++i) {
-            if (set[i].mesi == MESIState::INVALID) return static_cast<int>(i); // Prefer invalid
-            if (set[i].lru_counter < min_lru) {
-                min_lru = set[i].lru_counter;
-                lru_idx = static_cast<int>(i);
-            }
+    // The core accessed the way (or it supplied another cache)
+    void touch(const CacheSet& set, int way) {
+        if (policy == ReplacementPolicy::LRU) {
+            set.ages[way] = ++global_lru_counter;
+        } else {
+            policy_touch(set, way);
         }
-        return lru_idx;
     }
+    // A block was installed in the way; the access that missed on it follows as a touch
+    void inserted(const CacheSet& set, int way) {
+        if (policy == ReplacementPolicy::LRU) return;
+        set.valid[way / 64] |= uint64_t{1} << (way % 64);
+        policy_inserted(set, way);
+    }
+    // The way's block was invalidated
+    void invalidated(const CacheSet& set, int way) {
+        if (set.valid) set.valid[way / 64] &= ~(uint64_t{1} << (way % 64));
+    }
+    // Recomputes the valid-way masks from the states (after a checkpoint restore)
+    void rebuild_valid();
+
+private:
+    static constexpr uint64_t RANDOM_SEED = 0x9E3779B97F4A7C15;
+    static constexpr uint64_t BRRIP_LONG_EVERY = 32;
+
+    // One 64-byte aligned allocation holding the tag, state and prefetch arrays and the
+    // policy's replacement state
+    unsigned char* storage = nullptr;
+    uint32_t* tags = nullptr;
+    MESIState* states = nullptr;
+    uint64_t* ages = nullptr;
+    uint8_t* rrpv = nullptr;
+    uint64_t* plru = nullptr;
+    uint64_t* valid = nullptr;
+    uint8_t* prefetched = nullptr;
+
+    int policy_victim(const CacheSet& set);
+    void policy_touch(const CacheSet& set, int way);
+    void policy_inserted(const CacheSet& set, int way);
+    size_t storage_size() const;
+    void allocate();
 };
 
 // Bus transaction/request types for coherence
@@ -97,6 +289,15 @@ enum class BusRequestType {
     FLUSH,     // Flush: A core writes back a modified block to memory (usually on eviction)
 };
 
+// What a request granted on the split-transaction bus turned into
+struct SplitGrant {
+    BusRequestType type;
+    MESIState fill_state; // state the block is installed in on completion
+    bool has_data;        // needs a data transfer (everything but an upgrade)
+    bool from_memory;     // no other cache could supply the block
+    uint64_t latency;     // cycles after the grant cycle until the data is ready (LLC or memory)
+};
+
 struct Bus {
     int src_core;
     uint32_t addr;
@@ -109,20 +310,190 @@ struct Bus {
     BusRequestType prev_req_type;
     MESIState prev_mesi_state;
     bool evict;
+    bool prefetch = false; // the transaction is a prefetch (of the block at addr, for src_core)
+    bool demanded = false; // ... and src_core started waiting for that block before it arrived
 };
 
 // Cache controller for coherence
 class CacheController {
 public:
+    SimConfig config;
     std::vector<L1Cache> l1_caches;
     uint64_t total_bus_transactions = 0;
     uint64_t total_bus_traffic_bytes = 0;
+    SnoopFilter snoop_filter;
+    SharedLLC llc; // enabled with config.llc_kb
+    SharingProfiler* profiler = nullptr; // owned by the simulator, set with config.sharing_top
+    std::vector<PrefetchUnit> prefetch_units; // per core, with config.prefetch
+
+    explicit CacheController(const SimConfig& config)
+        : config(config), l1_caches(config.num_cores, L1Cache(config.s, config.E, config.b, config.replacement)),
+          snoop_filter(config.num_cores), holder_scratch(snoop_filter.words()) {
+        if (config.llc_kb) {
+            // An inclusive LLC sees every block the L1s hold, so it can stand in for the snoop filter
+            bool directory = config.snoop_filter && config.llc_policy == InclusionPolicy::INCLUSIVE;
+            llc = SharedLLC(config.llc_kb, config.llc_ways, config.llc_banks, config.b, config.llc_latency,
+                            config.memory_cycles, config.llc_policy, config.num_cores, directory);
+        }
+        if (config.prefetch != PrefetchKind::NONE) {
+            prefetch_units.resize(config.num_cores);
+            for (PrefetchUnit& unit : prefetch_units) unit.prefetcher = make_prefetcher(config.prefetch, config.prefetch_degree);
+        }
+    }
+
+    // Extract tag and set index from address
+    template <class G = GenericGeometry>
+    uint32_t get_tag(uint32_t addr) const { return addr >> (block_bits<G>() + config.s); }
+    template <class G = GenericGeometry>
+    uint32_t get_set_index(uint32_t addr) const { return (addr >> block_bits<G>()) & ((1 << config.s) - 1); }
 
-    CacheController(int num_cores, int s_bits, int E, int b_bits)
-        : l1_caches(num_cores, L1Cache(s_bits, E, b_bits)) {}
+    // Simulate a memory reference for a core; returns true once the access has completed
+    template <class G = GenericGeometry>
+    bool process_memory_access(int core_id, uint32_t addr, bool is_write, Bus& bus);
 
-    // Simulate a memory reference for a core
-    void process_memory_access(int core_id, uint32_t addr, bool is_write, Bus& bus);
-    
-    void mesi_snoop(Bus& bus);
+    void mesi_snoop(Bus& bus, uint64_t now);
+    // Charges a core whose access waits `cycles` cycles for the bus. Returns true if the bus
+    // holds a prefetch of the block the core waits for (the caller sets bus.demanded)
+    bool wait_for_bus(int core_id, uint32_t addr, const Bus& bus, uint64_t cycles = 1);
+
+    // True if some core has a prefetch queued for the bus
+    bool prefetch_pending() const;
+    // Puts the first queued prefetch (lowest core first) on the free bus; predictions that a
+    // cache has meanwhile filled are dropped. Returns false if none was left.
+    bool issue_prefetch(Bus& bus);
+
+    // Sampling: applies an access's effect on tags, MESI states and LRU order at once, with no
+    // bus timing and no statistics
+    template <class G = GenericGeometry>
+    void functional_access(int core_id, uint32_t addr, bool is_write);
+
+    // True if the access completes in the core's own cache without a bus transaction (and,
+    // not being the first use of a prefetched block, without training the prefetcher)
+    template <class G = GenericGeometry>
+    bool is_private_hit(int core_id, uint32_t addr, bool is_write) const;
+    // Performs the access if it is a private hit; otherwise changes nothing and returns false.
+    // count_cycle = false for a store drained from a store buffer (its cycle was counted when
+    // it was buffered).
+    template <class G = GenericGeometry>
+    bool try_private_hit(int core_id, uint32_t addr, bool is_write, bool count_cycle = true);
+
+    // Split bus: applies the coherence actions of a request at its grant
+    SplitGrant split_grant(int core_id, uint32_t addr, bool is_write, uint64_t now);
+    // Split bus: installs the block (or finishes the upgrade) and retires the access that
+    // missed, plus merged_loads loads a non-blocking cache merged into its MSHR. Returns true
+    // if a modified victim was evicted and must be written back, with its address in victim_addr.
+    bool split_complete(int core_id, uint32_t addr, bool is_write, const SplitGrant& grant, uint32_t& victim_addr,
+                        uint64_t now, uint32_t merged_loads = 0);
+
+    // Refills the snoop filter (or the LLC directory) from the caches' valid lines (after
+    // restoring a checkpoint)
+    void rebuild_snoop_filter();
+
+private:
+    std::vector<uint64_t> holder_scratch;
+
+    template <class G>
+    int block_bits() const {
+        if constexpr (G::BLOCK_BITS > 0) {
+            return G::BLOCK_BITS;
+        } else {
+            return config.b;
+        }
+    }
+
+    void retire_hit(int core_id, const CacheSet& set, int way, bool is_write, bool count_cycle = true);
+    uint32_t block_address(uint32_t tag, uint32_t set_idx) const;
+    // All changes between valid and INVALID go through these so the snoop filter stays exact
+    void fill_line(int core, uint32_t set_idx, const CacheSet& set, int way, uint32_t tag, MESIState state);
+    void invalidate_line(int core, uint32_t set_idx, const CacheSet& set, int way);
+    template <typename Visit>
+    void for_each_holder(uint32_t block, Visit&& visit);
+    void count_filter_lookup(int src_core, uint32_t block);
+    // Holder tracking in the snoop filter, or in the LLC when it is the directory
+    void add_holder(uint32_t block, int core);
+    void remove_holder(uint32_t block, int core);
+    bool find_holders(uint32_t block, uint64_t* out) const;
+
+    // LLC accesses; an inclusive LLC's evictions are applied to the L1s before they return
+    uint64_t llc_read(uint32_t block, uint64_t now);
+    uint64_t llc_write_back(uint32_t block, bool dropped, uint64_t now);
+    void llc_evicted(uint32_t block, bool dirty, uint64_t now);
+    void back_invalidate(const LLCEviction& victim);
+
+    // State a valid copy moves to when another cache reads the block
+    MESIState read_snooped_state(MESIState state) const;
+    // State a reader installs a block in that other caches keep
+    MESIState shared_fill_state() const;
+    // MOESI/MESIF: the one cache that answers requester's read of block (-1: memory)
+    int read_responder(uint32_t block, uint32_t set_idx, uint32_t tag, int requester);
+
+    // Prefetching: trains the core's prefetcher on block and queues its new predictions
+    void train_prefetcher(int core, uint32_t block);
+    // The core's first access to a prefetched line
+    void prefetch_used(int core, uint32_t set_idx, CacheLineRef line);
+    // A prefetch installed its block in line
+    void prefetch_filled(CacheLineRef line, Bus& bus);
+};
+
+// One complete simulation: caches, bus and per-core trace positions. Instances share
+// nothing but their (read-only) trace sources, so they are safe to run concurrently.
+class Simulator {
+public:
+    CacheController controller;
+    Bus bus{};
+    std::vector<CoreState> cores;
+    uint64_t global_cycle = 0;
+    size_t active_cores = 0;
+    std::unique_ptr<SplitBus> split_bus; // only with config.split_bus
+    std::vector<MissHandler> miss_handlers; // per core, only with config.mshrs (non-blocking L1s)
+    std::unique_ptr<Metrics> metrics;    // only with config.sample_interval
+    std::unique_ptr<Sampler> sampler;    // only with config.sampling_period
+    std::unique_ptr<SharingProfiler> profiler; // only with config.sharing_top
+
+    // sources[i] supplies core i's trace and must outlive the simulator
+    Simulator(const SimConfig& config, const std::vector<TraceSource*>& sources);
+    ~Simulator();
+
+    const SimConfig& config() const { return controller.config; }
+
+    // Runs until every core has finished its trace, or until it stops at config.checkpoint_at.
+    // With sampling the statistics are afterwards replaced by their estimates.
+    void run();
+    // Runs the cycle-level model until every active core has run out of trace or the cycle
+    // reaches stop_cycle
+    void simulate();
+    bool stopped_at_checkpoint = false;
+    uint64_t stop_cycle = UINT64_MAX;
+    // Sampling: applies the core's accesses up to trace index `goal` (or the end of its trace)
+    // functionally, with no timing. Returns how many of them were writes.
+    uint64_t run_functional(int core, size_t goal);
+
+private:
+    struct WindowResult {
+        size_t finished = 0;    // cores that ran out of trace in the window
+        uint64_t last_done = 0; // cycle (1-based) in which the last of them finished
+        bool demanded = false;  // a core started waiting for the block a prefetch is bringing
+    };
+
+    std::unique_ptr<WorkerPool> pool; // PARALLEL engine only
+    uint64_t pause_cycle = UINT64_MAX; // next cycle the loop must stop at for a checkpoint
+    std::vector<uint64_t> scan_hits;   // per core: private hits found so far by scan_private_hits
+
+    bool pause();
+    void schedule_pause();
+
+    // The loops are built per (instrumentation, geometry) pair; simulate() picks one at startup
+    template <bool Instrumented, class G> void run_loop();
+    template <bool Instrumented, class G> void step();
+    template <bool Instrumented, class G> void step_split();
+    template <bool Instrumented, class G> void step_nonblocking();
+    template <bool Instrumented, class G> uint64_t run_ahead();
+    template <bool Instrumented, class G> uint64_t run_ahead_split();
+    template <class G> uint64_t idle_window(uint64_t limit);
+    template <bool Instrumented, class G> WindowResult execute_window(uint64_t window);
+    template <class G> uint64_t scan_private_hits(int first, int last, uint64_t limit);
+    template <bool Instrumented, class G> WindowResult run_window(int first, int last, uint64_t window);
+    template <class G> uint64_t functional_loop(int core, size_t goal);
 };
+
+void print_stats(const Simulator& sim, std::ostream& out);
@@ -0,0 +1,77 @@
+#!/bin/sh
+# Simulator throughput benchmark: generates the synthetic traces, runs every pattern under
+# every cache configuration and engine, reports simulated accesses and cycles per second
+# and checks the statistics against bench/golden/.
+#
+#   bench/bench.sh                  run the suite (make bench)
+#   bench/bench.sh --update-golden  rewrite the golden outputs (make bench-golden)
+#
+# BENCH_CORES, BENCH_LENGTH (accesses per core), BENCH_ENGINES and BENCH_CONFIGS (s,E,b
+# triples) override the defaults; golden outputs only exist for the default cores/length.
+set -e
+cd "$(dirname "$0")"
+
+SIM=../L1simulate
+GEN=./tracegen
+DEFAULT_CORES=4
+DEFAULT_LENGTH=50000
+CORES=${BENCH_CORES:-$DEFAULT_CORES}
+LENGTH=${BENCH_LENGTH:-$DEFAULT_LENGTH}
+ENGINES=${BENCH_ENGINES:-"step event parallel"}
+CONFIGS=${BENCH_CONFIGS:-"6,2,5 8,8,6"}
+PATTERNS="streaming random sharing falsesharing migratory"
+
+update=0
+[ "$1" = "--update-golden" ] && update=1
+check=0
+[ "$CORES" = "$DEFAULT_CORES" ] && [ "$LENGTH" = "$DEFAULT_LENGTH" ] && check=1
+if [ $update = 1 ] && [ $check = 0 ]; then
+    echo "Error: golden outputs are only kept for $DEFAULT_CORES cores and $DEFAULT_LENGTH accesses" >&2
+    exit 1
+fi
+
+mkdir -p out golden
+failed=0
+printf "%-13s %-8s %-9s %9s %12s %12s  %s\n" pattern s,E,b engine seconds Maccess/s Mcycle/s golden
+for pattern in $PATTERNS; do
+    $GEN $pattern out/$pattern $CORES $LENGTH
+    for config in $CONFIGS; do
+        IFS=, read -r s E b <<CONFIG
+$config
+CONFIG
+        name=${pattern}_s${s}E${E}b${b}
+        for engine in $ENGINES; do
+            start=$(date +%s%N)
+            $SIM -t out/$pattern -s $s -E $E -b $b -o out/$name.txt --engine $engine -n $CORES > /dev/null
+            end=$(date +%s%N)
+
+            # Accesses = all instructions; simulated cycles = the last core's finishing cycle
+            stats=$(awk '/^Total Instructions:/ { n += $3 }
+                         /^Total Execution Cycles:/ { c = $4 }
+                         /^Idle Cycles:/ { if (c + $3 > m) m = c + $3 }
+                         END { print n, m }' out/$name.txt)
+            result=-
+            if [ $update = 1 ]; then
+                cp out/$name.txt golden/$name.txt
+                result=updated
+            elif [ $check = 1 ] && [ -f golden/$name.txt ]; then
+                if cmp -s out/$name.txt golden/$name.txt; then
+                    result=ok
+                else
+                    result=MISMATCH
+                    failed=1
+                fi
+            fi
+            echo $stats $start $end | awk -v p=$pattern -v c=$config -v e=$engine -v r=$result '{
+                secs = ($4 - $3) / 1e9
+                if (secs <= 0) secs = 1e-9
+                printf "%-13s %-8s %-9s %9.3f %12.2f %12.2f  %s\n", p, c, e, secs, $1 / secs / 1e6, $2 / secs / 1e6, r
+            }'
+        done
+    done
+done
+
+if [ $failed = 1 ]; then
+    echo "Statistics differ from bench/golden/ (rerun with --update-golden if the change is intended)" >&2
+    exit 1
+fi
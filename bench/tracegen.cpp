@@ -0,0 +1,118 @@
+// Deterministic synthetic trace generator for the benchmark suite.
+//
+//   ./tracegen <pattern> <prefix> <cores> <accesses per core> [seed]
+//
+// Writes <prefix>_proc<i>.trace for every core. The same arguments always produce the
+// same files: the generator uses its own PRNG rather than <random>, whose distributions
+// differ between standard libraries.
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// splitmix64
+struct Rng {
+    uint64_t state;
+    explicit Rng(uint64_t seed) : state(seed) {}
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    uint64_t below(uint64_t n) { return next() % n; }
+    bool chance(int percent) { return below(100) < static_cast<uint64_t>(percent); }
+};
+
+struct Access {
+    char op;
+    uint32_t addr;
+};
+
+constexpr uint32_t PRIVATE_REGION = 1u << 24; // 16 MB of private address space per core
+constexpr uint32_t SHARED_BASE = 0xF0000000u;
+
+// Each pattern yields access i of a core's trace; cores are numbered 0..cores-1
+using Pattern = Access (*)(int core, int cores, uint64_t i, Rng& rng);
+
+// Sequential walk over a private array, mostly reads
+static Access streaming(int core, int, uint64_t i, Rng& rng) {
+    uint32_t addr = core * PRIVATE_REGION + static_cast<uint32_t>(i * 4 % (PRIVATE_REGION / 2));
+    return {rng.chance(20) ? 'W' : 'R', addr};
+}
+
+// Uniform random words in a 1 MB private region
+static Access random_private(int core, int, uint64_t, Rng& rng) {
+    uint32_t addr = core * PRIVATE_REGION + static_cast<uint32_t>(rng.below(1u << 18) * 4);
+    return {rng.chance(30) ? 'W' : 'R', addr};
+}
+
+// Every core reads and writes the same 4 KB of shared data
+static Access high_sharing(int, int, uint64_t, Rng& rng) {
+    uint32_t addr = SHARED_BASE + static_cast<uint32_t>(rng.below(1024) * 4);
+    return {rng.chance(30) ? 'W' : 'R', addr};
+}
+
+// Each core writes its own word of the same few 64-byte blocks
+static Access false_sharing(int core, int, uint64_t i, Rng& rng) {
+    uint32_t block = static_cast<uint32_t>(rng.below(8));
+    uint32_t addr = SHARED_BASE + block * 64 + static_cast<uint32_t>(core % 16) * 4;
+    return {i % 4 == 0 ? 'R' : 'W', addr};
+}
+
+// Objects handed from core to core: core c works on object (k + c) in step k, reading and
+// then writing each of its words, so every object moves to the next core each step
+static Access migratory(int core, int, uint64_t i, Rng&) {
+    constexpr uint64_t OBJECT_WORDS = 8;
+    constexpr uint64_t OBJECTS = 64;
+    uint64_t step = i / (2 * OBJECT_WORDS);
+    uint64_t word = (i / 2) % OBJECT_WORDS;
+    uint32_t object = static_cast<uint32_t>((step + core) % OBJECTS);
+    return {i % 2 == 0 ? 'R' : 'W', SHARED_BASE + object * 64 + static_cast<uint32_t>(word * 4)};
+}
+
+static Pattern find_pattern(const char* name) {
+    if (strcmp(name, "streaming") == 0) return streaming;
+    if (strcmp(name, "random") == 0) return random_private;
+    if (strcmp(name, "sharing") == 0) return high_sharing;
+    if (strcmp(name, "falsesharing") == 0) return false_sharing;
+    if (strcmp(name, "migratory") == 0) return migratory;
+    return nullptr;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 5 || argc > 6) {
+        fprintf(stderr, "Usage: %s <streaming|random|sharing|falsesharing|migratory> <prefix> <cores> <accesses> [seed]\n",
+                argv[0]);
+        return 1;
+    }
+    Pattern pattern = find_pattern(argv[1]);
+    if (!pattern) {
+        fprintf(stderr, "Error: unknown pattern %s\n", argv[1]);
+        return 1;
+    }
+    int cores = atoi(argv[3]);
+    uint64_t length = strtoull(argv[4], nullptr, 10);
+    uint64_t seed = argc == 6 ? strtoull(argv[5], nullptr, 10) : 1;
+    if (cores < 1 || length == 0) {
+        fprintf(stderr, "Error: cores and accesses must be positive\n");
+        return 1;
+    }
+
+    for (int core = 0; core < cores; ++core) {
+        std::string path = std::string(argv[2]) + "_proc" + std::to_string(core) + ".trace";
+        FILE* out = fopen(path.c_str(), "w");
+        if (!out) {
+            fprintf(stderr, "Error: cannot write %s\n", path.c_str());
+            return 1;
+        }
+        Rng rng(seed * 0x100000001B3ull + static_cast<uint64_t>(core));
+        for (uint64_t i = 0; i < length; ++i) {
+            Access a = pattern(core, cores, i, rng);
+            fprintf(out, "%c 0x%x\n", a.op, a.addr);
+        }
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,196 @@
+#include "cache_simd.hpp"
+
+#if defined(__x86_64__) && !defined(L1SIM_SCALAR)
+#include <immintrin.h>
+#define L1SIM_X86 1
+#endif
+
+[[maybe_unused]] static int scalar_find_tag(const uint32_t* tags, int ways, uint32_t tag) {
+    for (int i = 0; i < ways; ++i) {
+        if (tags[i] == tag) return i;
+    }
+    return -1;
+}
+
+[[maybe_unused]] static int scalar_first_invalid(const uint8_t* states, int ways) {
+    for (int i = 0; i < ways; ++i) {
+        if (states[i] == 0) return i;
+    }
+    return -1;
+}
+
+static int scalar_oldest(const uint64_t* ages, int ways) {
+    uint64_t min_age = UINT64_MAX;
+    int victim = 0;
+    for (int i = 0; i < ways; ++i) {
+        if (ages[i] < min_age) {
+            min_age = ages[i];
+            victim = i;
+        }
+    }
+    return victim;
+}
+
+[[maybe_unused]] static int scalar_rrip_victim(uint8_t* rrpv, int ways, uint8_t value_mask, uint8_t max_rrpv) {
+    int victim = 0;
+    for (int i = 1; i < ways; ++i) {
+        if ((rrpv[i] & value_mask) > (rrpv[victim] & value_mask)) victim = i;
+    }
+    uint8_t age = max_rrpv - (rrpv[victim] & value_mask);
+    if (age) {
+        for (int i = 0; i < ways; ++i) rrpv[i] += age;
+    }
+    return victim;
+}
+
+#ifdef L1SIM_X86
+// SSE2 is part of x86-64, so these need no target attribute
+static int sse2_find_tag(const uint32_t* tags, int ways, uint32_t tag) {
+    __m128i key = _mm_set1_epi32(static_cast<int>(tag));
+    for (int w = 0; w < ways; w += 4) {
+        __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(tags + w));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, key)));
+        if (mask) {
+            int i = w + __builtin_ctz(mask);
+            return i < ways ? i : -1;
+        }
+    }
+    return -1;
+}
+
+static int sse2_first_invalid(const uint8_t* states, int ways) {
+    __m128i zero = _mm_setzero_si128();
+    for (int w = 0; w < ways; w += 8) {
+        __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(states + w));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) & 0xFF;
+        if (mask) return w + __builtin_ctz(mask); // padding is never 0
+    }
+    return -1;
+}
+
+// Sets are padded to CACHE_WAY_PAD (8) ways, so 8-byte loads stay inside the set; lanes
+// past the last way are masked out of the search and the ageing
+static int sse2_rrip_victim(uint8_t* rrpv, int ways, uint8_t value_mask, uint8_t max_rrpv) {
+    const __m128i lane = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m128i value = _mm_set1_epi8(static_cast<char>(value_mask));
+    auto live = [&](int w) {
+        return _mm_cmplt_epi8(lane, _mm_set1_epi8(static_cast<char>(ways - w < 8 ? ways - w : 8)));
+    };
+    auto load = [&](int w) { return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(rrpv + w)); };
+
+    __m128i top = _mm_setzero_si128();
+    for (int w = 0; w < ways; w += 8) {
+        top = _mm_max_epu8(top, _mm_and_si128(_mm_and_si128(load(w), value), live(w)));
+    }
+    top = _mm_max_epu8(top, _mm_srli_epi64(top, 32));
+    top = _mm_max_epu8(top, _mm_srli_epi64(top, 16));
+    top = _mm_max_epu8(top, _mm_srli_epi64(top, 8));
+    uint8_t max_value = static_cast<uint8_t>(_mm_cvtsi128_si32(top));
+
+    __m128i key = _mm_set1_epi8(static_cast<char>(max_value));
+    int victim = 0;
+    for (int w = 0; w < ways; w += 8) {
+        __m128i in_set = live(w);
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(load(w), value), key), in_set));
+        if (mask) {
+            victim = w + __builtin_ctz(mask);
+            break;
+        }
+    }
+
+    uint8_t age = max_rrpv - max_value;
+    if (age) {
+        __m128i step = _mm_set1_epi8(static_cast<char>(age));
+        for (int w = 0; w < ways; w += 8) {
+            __m128i v = _mm_add_epi8(load(w), _mm_and_si128(step, live(w)));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(rrpv + w), v);
+        }
+    }
+    return victim;
+}
+
+__attribute__((target("avx2"))) static int avx2_find_tag(const uint32_t* tags, int ways, uint32_t tag) {
+    __m256i key = _mm256_set1_epi32(static_cast<int>(tag));
+    for (int w = 0; w < ways; w += 8) {
+        __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i*>(tags + w));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, key)));
+        if (mask) {
+            int i = w + __builtin_ctz(mask);
+            return i < ways ? i : -1;
+        }
+    }
+    return -1;
+}
+
+// Ages are LRU counters (< 2^63) and padding is INT64_MAX, so signed 64-bit compares are safe
+__attribute__((target("avx2"))) static int avx2_oldest(const uint64_t* ages, int ways) {
+    __m256i best = _mm256_set1_epi64x(INT64_MAX);
+    for (int w = 0; w < ways; w += 4) {
+        __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i*>(ages + w));
+        best = _mm256_blendv_epi8(best, v, _mm256_cmpgt_epi64(best, v));
+    }
+    alignas(32) int64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), best);
+    int64_t min_age = lanes[0];
+    for (int i = 1; i < 4; ++i) min_age = lanes[i] < min_age ? lanes[i] : min_age;
+
+    __m256i key = _mm256_set1_epi64x(min_age);
+    for (int w = 0; w < ways; w += 4) {
+        __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i*>(ages + w));
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, key)));
+        if (mask) return w + __builtin_ctz(mask);
+    }
+    return 0;
+}
+#endif
+
+enum class SimdLevel { SCALAR, SSE2, AVX2 };
+
+static SimdLevel detect_simd() {
+#ifdef L1SIM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    return SimdLevel::SSE2;
+#else
+    return SimdLevel::SCALAR;
+#endif
+}
+
+static const SimdLevel simd_level = detect_simd();
+
+int find_tag_simd(const uint32_t* tags, int ways, uint32_t tag) {
+#ifdef L1SIM_X86
+    if (simd_level == SimdLevel::AVX2) return avx2_find_tag(tags, ways, tag);
+    return sse2_find_tag(tags, ways, tag);
+#else
+    return scalar_find_tag(tags, ways, tag);
+#endif
+}
+
+int find_victim_simd(const uint8_t* states, const uint64_t* ages, int ways) {
+#ifdef L1SIM_X86
+    int invalid = sse2_first_invalid(states, ways);
+    if (invalid >= 0) return invalid;
+    if (simd_level == SimdLevel::AVX2) return avx2_oldest(ages, ways);
+    return scalar_oldest(ages, ways);
+#else
+    int invalid = scalar_first_invalid(states, ways);
+    return invalid >= 0 ? invalid : scalar_oldest(ages, ways);
+#endif
+}
+
+int rrip_victim_simd(uint8_t* rrpv, int ways, uint8_t value_mask, uint8_t max_rrpv) {
+#ifdef L1SIM_X86
+    return sse2_rrip_victim(rrpv, ways, value_mask, max_rrpv);
+#else
+    return scalar_rrip_victim(rrpv, ways, value_mask, max_rrpv);
+#endif
+}
+
+const char* simd_kernel_name() {
+    switch (simd_level) {
+        case SimdLevel::AVX2: return "avx2";
+        case SimdLevel::SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
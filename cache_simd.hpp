@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+
+#if defined(__SSE2__) && !defined(L1SIM_SCALAR)
+#include <emmintrin.h>
+#endif
+
+// Way-scan kernels for the structure-of-arrays L1Cache layout. Each set's tags, states
+// and ages start on a 32-byte boundary and are padded to a multiple of CACHE_WAY_PAD
+// ways; padding lines hold PAD_STATE and PAD_AGE so they never look invalid or oldest.
+inline constexpr int CACHE_WAY_PAD = 8;
+inline constexpr uint8_t PAD_STATE = 0xFF;
+inline constexpr uint64_t PAD_AGE = INT64_MAX;
+
+// Sets narrower than this are scanned with the inline scalar loops below
+inline constexpr int SIMD_MIN_WAYS = 8;
+
+// Index of the first way whose tag matches, or -1
+int find_tag_simd(const uint32_t* tags, int ways, uint32_t tag);
+// First invalid (state 0) way, otherwise the first way with the smallest age
+int find_victim_simd(const uint8_t* states, const uint64_t* ages, int ways);
+// RRIP victim: the first way whose value (rrpv & value_mask) is largest; unless that is
+// max_rrpv, every way is aged by the difference first. Padding ways are left untouched.
+int rrip_victim_simd(uint8_t* rrpv, int ways, uint8_t value_mask, uint8_t max_rrpv);
+// "avx2", "sse2" or "scalar", chosen once from the running CPU
+const char* simd_kernel_name();
+
+inline int find_tag(const uint32_t* tags, int ways, uint32_t tag) {
+    if (ways >= SIMD_MIN_WAYS) return find_tag_simd(tags, ways, tag);
+    for (int i = 0; i < ways; ++i) {
+        if (tags[i] == tag) return i;
+    }
+    return -1;
+}
+
+inline int find_victim(const uint8_t* states, const uint64_t* ages, int ways) {
+    if (ways >= SIMD_MIN_WAYS) return find_victim_simd(states, ages, ways);
+    uint64_t min_age = UINT64_MAX;
+    int victim = 0;
+    for (int i = 0; i < ways; ++i) {
+        if (states[i] == 0) return i; // Prefer invalid
+        if (ages[i] < min_age) {
+            min_age = ages[i];
+            victim = i;
+        }
+    }
+    return victim;
+}
+
+inline int rrip_victim(uint8_t* rrpv, int ways, uint8_t value_mask, uint8_t max_rrpv) {
+    if (ways >= SIMD_MIN_WAYS) return rrip_victim_simd(rrpv, ways, value_mask, max_rrpv);
+    int victim = 0;
+    for (int i = 1; i < ways; ++i) {
+        if ((rrpv[i] & value_mask) > (rrpv[victim] & value_mask)) victim = i;
+    }
+    uint8_t age = max_rrpv - (rrpv[victim] & value_mask);
+    if (age) {
+        for (int i = 0; i < ways; ++i) rrpv[i] += age;
+    }
+    return victim;
+}
+
+// Way scans for a set size fixed at compile time (the specialised cache geometries): the
+// loops unroll completely, and from 4 ways up the tag compare is a few inline SSE2 compares
+template <int Ways>
+inline int find_tag_fixed(const uint32_t* tags, uint32_t tag) {
+    static_assert(Ways > 0 && Ways <= 32, "unsupported set size");
+#if defined(__SSE2__) && !defined(L1SIM_SCALAR)
+    if constexpr (Ways >= 4) {
+        __m128i key = _mm_set1_epi32(static_cast<int>(tag));
+        uint64_t match = 0;
+        for (int w = 0; w < Ways; w += 4) {
+            __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(tags + w));
+            match |= static_cast<uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, key)))) << w;
+        }
+        match &= (uint64_t{1} << Ways) - 1; // padding ways
+        return match ? __builtin_ctzll(match) : -1;
+    }
+#endif
+    for (int i = 0; i < Ways; ++i) {
+        if (tags[i] == tag) return i;
+    }
+    return -1;
+}
+
+template <int Ways>
+inline int find_victim_fixed(const uint8_t* states, const uint64_t* ages) {
+    static_assert(Ways > 0 && Ways <= 32, "unsupported set size");
+    for (int i = 0; i < Ways; ++i) {
+        if (states[i] == 0) return i; // Prefer invalid
+    }
+    int victim = 0;
+    for (int i = 1; i < Ways; ++i) {
+        if (ages[i] < ages[victim]) victim = i;
+    }
+    return victim;
+}
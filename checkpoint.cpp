@@ -0,0 +1,268 @@
+#include "checkpoint.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include "L1simulate.hpp"
+#include "split_bus.hpp"
+
+volatile sig_atomic_t checkpoint_requested = 0;
+
+static void on_checkpoint_signal(int) {
+    checkpoint_requested = 1;
+}
+
+void install_checkpoint_signal() {
+    struct sigaction action {};
+    action.sa_handler = on_checkpoint_signal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, nullptr);
+}
+
+// Configuration a checkpoint was taken with
+struct CheckpointHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t num_cores;
+    int32_t s;
+    int32_t E;
+    int32_t b;
+    uint8_t split_bus;
+    uint8_t llc_policy;
+    uint8_t prefetch;
+    uint8_t protocol;
+    uint8_t replacement;
+    uint8_t mshrs;        // 0 with blocking L1s
+    uint8_t store_buffer;
+    uint8_t reserved[1];
+    uint64_t llc_kb; // 0 without an LLC
+    int32_t llc_ways;
+    int32_t llc_banks;
+};
+
+static void put_bus(CheckpointWriter& out, const Bus& bus) {
+    out.put(bus.src_core);
+    out.put(bus.addr);
+    out.put(bus.req_type);
+    out.put(bus.cycles_remaining);
+    out.put(bus.resp_core);
+    out.put(bus.available);
+    out.put(bus.done);
+    out.put(bus.prev_core);
+    out.put(bus.prev_req_type);
+    out.put(bus.prev_mesi_state);
+    out.put(bus.evict);
+    out.put(bus.prefetch);
+    out.put(bus.demanded);
+}
+
+static void get_bus(CheckpointReader& in, Bus& bus) {
+    in.get(bus.src_core);
+    in.get(bus.addr);
+    in.get(bus.req_type);
+    in.get(bus.cycles_remaining);
+    in.get(bus.resp_core);
+    in.get(bus.available);
+    in.get(bus.done);
+    in.get(bus.prev_core);
+    in.get(bus.prev_req_type);
+    in.get(bus.prev_mesi_state);
+    in.get(bus.evict);
+    in.get(bus.prefetch);
+    in.get(bus.demanded);
+}
+
+bool save_checkpoint(const Simulator& sim, const std::string& path) {
+    const SimConfig& config = sim.config();
+    std::string tmp = path + ".tmp";
+    FILE* file = fopen(tmp.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Error: cannot write checkpoint " << tmp << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    CheckpointWriter out(file);
+
+    CheckpointHeader header{};
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.num_cores = config.num_cores;
+    header.s = config.s;
+    header.E = config.E;
+    header.b = config.b;
+    header.split_bus = config.split_bus;
+    header.llc_policy = static_cast<uint8_t>(config.llc_policy);
+    header.prefetch = static_cast<uint8_t>(config.prefetch);
+    header.protocol = static_cast<uint8_t>(config.protocol);
+    header.replacement = static_cast<uint8_t>(config.replacement);
+    header.mshrs = static_cast<uint8_t>(config.mshrs);
+    header.store_buffer = config.mshrs ? static_cast<uint8_t>(config.store_buffer) : 0;
+    header.llc_kb = config.llc_kb;
+    header.llc_ways = config.llc_ways;
+    header.llc_banks = config.llc_banks;
+    out.put(header);
+    // Which traces the state belongs to
+    out.put_vector(std::vector<char>(config.tracefile.begin(), config.tracefile.end()));
+    std::vector<uint64_t> lengths;
+    for (const CoreState& core : sim.cores) lengths.push_back(core.cursor.length());
+    out.put_vector(lengths);
+
+    out.put(sim.global_cycle);
+    put_bus(out, sim.bus);
+    for (const CoreState& core : sim.cores) {
+        out.put<uint64_t>(core.pc);
+        out.put(core.done);
+        out.put(core.waiting);
+    }
+
+    const CacheController& controller = sim.controller;
+    for (const L1Cache& cache : controller.l1_caches) {
+        for (int i = 0; i < cache.S; ++i) {
+            CacheSet set = cache.set(i);
+            out.put_bytes(set.tags, sizeof(uint32_t) * set.ways);
+            out.put_bytes(set.states, sizeof(MESIState) * set.ways);
+            if (set.ages) out.put_bytes(set.ages, sizeof(uint64_t) * set.ways);
+            if (set.rrpv) out.put_bytes(set.rrpv, set.ways);
+            if (set.plru) out.put_bytes(set.plru, sizeof(uint64_t) * cache.plru_words);
+            out.put_bytes(set.prefetched, set.ways);
+        }
+        out.put(cache.global_lru_counter);
+        if (cache.policy != ReplacementPolicy::LRU) {
+            out.put(cache.random_state);
+            out.put(cache.brrip_fills);
+        }
+        out.put(cache.stats);
+    }
+    out.put(controller.total_bus_transactions);
+    out.put(controller.total_bus_traffic_bytes);
+    out.put(controller.snoop_filter.stats);
+    if (sim.split_bus) sim.split_bus->save(out);
+    if (controller.llc.enabled()) controller.llc.save(out);
+    for (const PrefetchUnit& unit : controller.prefetch_units) {
+        out.put_vector(std::vector<uint32_t>(unit.queue.begin(), unit.queue.end()));
+        unit.prefetcher->save(out);
+    }
+    for (const MissHandler& handler : sim.miss_handlers) handler.save(out);
+
+    bool ok = out.ok();
+    if (fclose(file) != 0) ok = false;
+    if (ok && rename(tmp.c_str(), path.c_str()) != 0) ok = false;
+    if (!ok) {
+        std::cerr << "Error: failed writing checkpoint " << path << ": " << strerror(errno) << "\n";
+        remove(tmp.c_str());
+    }
+    return ok;
+}
+
+bool load_checkpoint(Simulator& sim, const std::string& path) {
+    const SimConfig& config = sim.config();
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        std::cerr << "Error: cannot open checkpoint " << path << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    CheckpointReader in(file);
+
+    CheckpointHeader header{};
+    const char* reason = nullptr;
+    if (!in.get(header) || memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0) reason = "not a checkpoint";
+    else if (header.version != CHECKPOINT_VERSION) reason = "unsupported version";
+    else if (header.num_cores != config.num_cores) reason = "number of cores differs (-n)";
+    else if (header.s != config.s || header.E != config.E || header.b != config.b) reason = "cache geometry differs (-s/-E/-b)";
+    else if (header.split_bus != config.split_bus) reason = "bus model differs (--split-bus)";
+    else if (header.llc_kb != config.llc_kb ||
+             (config.llc_kb && (header.llc_ways != config.llc_ways || header.llc_banks != config.llc_banks ||
+                                header.llc_policy != static_cast<uint8_t>(config.llc_policy))))
+        reason = "LLC configuration differs (--llc/--llc-ways/--llc-banks/--llc-policy)";
+    else if (header.prefetch != static_cast<uint8_t>(config.prefetch)) reason = "prefetcher differs (--prefetch)";
+    else if (header.protocol != static_cast<uint8_t>(config.protocol)) reason = "coherence protocol differs (--protocol)";
+    else if (header.replacement != static_cast<uint8_t>(config.replacement)) reason = "replacement policy differs (--replacement)";
+    else if (header.mshrs != config.mshrs || (config.mshrs && header.store_buffer != config.store_buffer))
+        reason = "non-blocking L1 configuration differs (--mshrs/--store-buffer)";
+    if (!reason) {
+        std::vector<char> prefix;
+        std::vector<uint64_t> lengths;
+        in.get_vector(prefix);
+        in.get_vector(lengths);
+        if (!in.ok() || lengths.size() != sim.cores.size()) {
+            reason = "truncated or corrupt checkpoint";
+        } else if (std::string(prefix.begin(), prefix.end()) != config.tracefile) {
+            reason = "trace differs (-t)";
+        } else {
+            for (size_t i = 0; i < lengths.size(); ++i) {
+                uint64_t length = sim.cores[i].cursor.length();
+                // A streamed trace's length is not known up front
+                if (lengths[i] != TraceSource::UNKNOWN_LENGTH && length != TraceSource::UNKNOWN_LENGTH &&
+                    lengths[i] != length) {
+                    reason = "trace length differs (the trace files changed)";
+                }
+            }
+        }
+    }
+    if (reason) {
+        std::cerr << "Error: " << path << ": " << reason << "\n";
+        fclose(file);
+        return false;
+    }
+
+    in.get(sim.global_cycle);
+    get_bus(in, sim.bus);
+    sim.active_cores = 0;
+    for (CoreState& core : sim.cores) {
+        uint64_t pc = 0;
+        in.get(pc);
+        core.pc = pc;
+        in.get(core.done);
+        in.get(core.waiting);
+        if (!core.done) sim.active_cores++;
+    }
+
+    CacheController& controller = sim.controller;
+    for (L1Cache& cache : controller.l1_caches) {
+        for (int i = 0; i < cache.S; ++i) {
+            CacheSet set = cache.set(i);
+            in.get_bytes(set.tags, sizeof(uint32_t) * set.ways);
+            in.get_bytes(set.states, sizeof(MESIState) * set.ways);
+            if (set.ages) in.get_bytes(set.ages, sizeof(uint64_t) * set.ways);
+            if (set.rrpv) in.get_bytes(set.rrpv, set.ways);
+            if (set.plru) in.get_bytes(set.plru, sizeof(uint64_t) * cache.plru_words);
+            in.get_bytes(set.prefetched, set.ways);
+        }
+        cache.rebuild_valid();
+        in.get(cache.global_lru_counter);
+        if (cache.policy != ReplacementPolicy::LRU) {
+            in.get(cache.random_state);
+            in.get(cache.brrip_fills);
+        }
+        in.get(cache.stats);
+    }
+    in.get(controller.total_bus_transactions);
+    in.get(controller.total_bus_traffic_bytes);
+    SnoopFilter::Stats filter_stats;
+    in.get(filter_stats);
+    if (sim.split_bus) reason = sim.split_bus->load(in);
+    if (!reason) {
+        if (controller.llc.enabled()) controller.llc.load(in);
+        for (PrefetchUnit& unit : controller.prefetch_units) {
+            std::vector<uint32_t> queue;
+            in.get_vector(queue);
+            unit.queue.assign(queue.begin(), queue.end());
+            unit.prefetcher->load(in);
+        }
+        for (MissHandler& handler : sim.miss_handlers) {
+            if (!reason) reason = handler.load(in);
+        }
+        if (!reason && (!in.ok() || fgetc(file) != EOF)) reason = "truncated or corrupt checkpoint";
+    }
+    fclose(file);
+    if (reason) {
+        std::cerr << "Error: " << path << ": " << reason << "\n";
+        return false;
+    }
+    // The filter's (and LLC directory's) contents follow from the caches, so it is rebuilt
+    // rather than stored
+    controller.rebuild_snoop_filter();
+    controller.snoop_filter.stats = filter_stats;
+    return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+class Simulator;
+
+// Checkpoint file layout: a header (magic "L1CK", version, the configuration it was taken
+// with), the trace prefix and each core's trace length, then the simulator state in a fixed order: cycle and bus, per-core trace position,
+// per-core cache lines (E ways per set, no padding), LRU counters and statistics, bus
+// totals, snoop filter statistics, with the split bus its queue and transactions, with the
+// shared LLC its lines and bank state and, with prefetching, each core's queue and detector.
+inline constexpr char CHECKPOINT_MAGIC[4] = {'L', '1', 'C', 'K'};
+inline constexpr uint32_t CHECKPOINT_VERSION = 4;
+
+// Sequential binary writer; errors are sticky and reported by ok()
+class CheckpointWriter {
+public:
+    explicit CheckpointWriter(FILE* out) : out(out) {}
+
+    void put_bytes(const void* data, size_t len) {
+        if (good && len && fwrite(data, 1, len, out) != len) good = false;
+    }
+    template <typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "checkpoint fields must be trivially copyable");
+        put_bytes(&value, sizeof(T));
+    }
+    template <typename T>
+    void put_vector(const std::vector<T>& values) {
+        put<uint64_t>(values.size());
+        put_bytes(values.data(), values.size() * sizeof(T));
+    }
+    bool ok() const { return good; }
+
+private:
+    FILE* out;
+    bool good = true;
+};
+
+// Sequential binary reader; a short read makes every later get() fail
+class CheckpointReader {
+public:
+    explicit CheckpointReader(FILE* in) : in(in) {}
+
+    bool get_bytes(void* data, size_t len) {
+        if (good && len && fread(data, 1, len, in) != len) good = false;
+        return good;
+    }
+    template <typename T>
+    bool get(T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "checkpoint fields must be trivially copyable");
+        return get_bytes(&value, sizeof(T));
+    }
+    template <typename T>
+    bool get_vector(std::vector<T>& values) {
+        uint64_t n = 0;
+        if (!get(n) || n > (uint64_t{1} << 32)) return good = false;
+        values.resize(n);
+        return get_bytes(values.data(), n * sizeof(T));
+    }
+    bool ok() const { return good; }
+
+private:
+    FILE* in;
+    bool good = true;
+};
+
+// Writes the simulator's complete state to path (through a temporary file, so an existing
+// checkpoint is only replaced by a complete one). Returns false with a message on stderr.
+bool save_checkpoint(const Simulator& sim, const std::string& path);
+
+// Replaces a freshly constructed simulator's state with a checkpoint. The number of cores,
+// the traces (prefix and length), the cache geometry, the replacement policy, the bus model, the non-blocking L1 setup, the
+// coherence protocol, the LLC organisation and the prefetcher must match the checkpoint; the engine, snoop filter, latencies, prefetch degree
+// and other options may differ. Returns false with a message on stderr.
+bool load_checkpoint(Simulator& sim, const std::string& path);
+
+// Makes SIGUSR1 request a checkpoint at the next point the run can pause
+void install_checkpoint_signal();
+// Set by the SIGUSR1 handler, cleared once the checkpoint is written
+extern volatile sig_atomic_t checkpoint_requested;
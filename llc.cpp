@@ -0,0 +1,170 @@
+#include "llc.hpp"
+
+#include <algorithm>
+
+#include "checkpoint.hpp"
+
+SharedLLC::SharedLLC(uint64_t size_kb, int ways, int banks, int block_bits, uint64_t latency, uint64_t memory_cycles,
+                     InclusionPolicy policy, int num_cores, bool directory)
+    : ways(ways), num_sets(static_cast<int>((size_kb * 1024 >> block_bits) / ways)), num_banks(banks),
+      latency(latency), memory_cycles(memory_cycles), policy(policy), directory(directory),
+      words_per_line(directory ? (num_cores + 63) / 64 : 0) {
+    size_t lines = static_cast<size_t>(num_sets) * ways;
+    tags.assign(lines, NO_BLOCK);
+    states.assign(lines, INVALID);
+    ages.assign(lines, 0);
+    presence.assign(lines * words_per_line, 0);
+    bank_free.assign(num_banks, 0);
+    bank_stats.resize(num_banks);
+}
+
+long SharedLLC::find(uint32_t block) const {
+    size_t base = set_of(block) * ways;
+    for (int way = 0; way < ways; ++way) {
+        if (tags[base + way] == block) return static_cast<long>(base + way);
+    }
+    return -1;
+}
+
+size_t SharedLLC::install(uint32_t block, uint8_t state, LLCEviction& victim) {
+    size_t base = set_of(block) * ways;
+    size_t line = base;
+    for (int way = 0; way < ways; ++way) {
+        if (states[base + way] == INVALID) {
+            line = base + way;
+            break;
+        }
+        if (ages[base + way] < ages[line]) line = base + way;
+    }
+    if (states[line] != INVALID) {
+        LLCBankStats& stats = bank_stats[bank_of(block)];
+        stats.evictions++;
+        if (states[line] == DIRTY) stats.memory_writebacks++;
+        victim.valid = true;
+        victim.block = tags[line];
+        victim.holders.assign(presence.begin() + line * words_per_line, presence.begin() + (line + 1) * words_per_line);
+    }
+    tags[line] = block;
+    states[line] = state;
+    ages[line] = ++lru_counter;
+    std::fill_n(presence.begin() + line * words_per_line, words_per_line, 0);
+    return line;
+}
+
+void SharedLLC::remove(size_t line) {
+    tags[line] = NO_BLOCK;
+    states[line] = INVALID;
+}
+
+uint64_t SharedLLC::occupy(uint32_t block, uint64_t now) {
+    int bank = bank_of(block);
+    uint64_t start = std::max(now, bank_free[bank]);
+    bank_free[bank] = start + latency;
+    bank_stats[bank].busy_cycles += latency;
+    bank_stats[bank].conflict_cycles += start - now;
+    return start - now + latency;
+}
+
+uint64_t SharedLLC::read(uint32_t block, uint64_t now, LLCEviction& victim) {
+    LLCBankStats& stats = bank_stats[bank_of(block)];
+    stats.reads++;
+    uint64_t cycles = occupy(block, now);
+    long line = find(block);
+    if (line >= 0) {
+        stats.read_hits++;
+        if (policy == InclusionPolicy::EXCLUSIVE) {
+            // The block moves up to the L1; dirty data goes to memory on the way
+            if (states[line] == DIRTY) stats.memory_writebacks++;
+            remove(line);
+        } else {
+            ages[line] = ++lru_counter;
+        }
+        return cycles;
+    }
+    if (policy != InclusionPolicy::EXCLUSIVE) install(block, CLEAN, victim);
+    return cycles + memory_cycles;
+}
+
+uint64_t SharedLLC::write_back(uint32_t block, bool dropped, uint64_t now, LLCEviction& victim) {
+    LLCBankStats& stats = bank_stats[bank_of(block)];
+    if (policy == InclusionPolicy::EXCLUSIVE && !dropped) {
+        // Another L1 keeps the block, so it has no place in an exclusive LLC
+        stats.memory_writebacks++;
+        return memory_cycles;
+    }
+    stats.writes++;
+    uint64_t cycles = occupy(block, now);
+    long line = find(block);
+    if (line >= 0) {
+        states[line] = DIRTY;
+        ages[line] = ++lru_counter;
+    } else {
+        install(block, DIRTY, victim);
+    }
+    return cycles;
+}
+
+void SharedLLC::clean_eviction(uint32_t block, LLCEviction& victim) {
+    if (policy != InclusionPolicy::EXCLUSIVE) return;
+    bank_stats[bank_of(block)].writes++;
+    long line = find(block);
+    if (line >= 0) {
+        ages[line] = ++lru_counter;
+    } else {
+        install(block, CLEAN, victim);
+    }
+}
+
+void SharedLLC::filled(uint32_t block, LLCEviction& victim) {
+    if (policy != InclusionPolicy::INCLUSIVE || find(block) >= 0) return;
+    install(block, CLEAN, victim);
+}
+
+void SharedLLC::back_invalidated(uint32_t block, bool dirty) {
+    LLCBankStats& stats = bank_stats[bank_of(block)];
+    stats.back_invalidations++;
+    if (dirty) stats.memory_writebacks++;
+}
+
+void SharedLLC::add_holder(uint32_t block, int core) {
+    long line = find(block);
+    if (line >= 0) presence[line * words_per_line + core / 64] |= uint64_t{1} << (core % 64);
+}
+
+void SharedLLC::remove_holder(uint32_t block, int core) {
+    long line = find(block);
+    if (line >= 0) presence[line * words_per_line + core / 64] &= ~(uint64_t{1} << (core % 64));
+}
+
+bool SharedLLC::holders(uint32_t block, uint64_t* out) const {
+    long line = find(block);
+    if (line < 0) return false;
+    bool any = false;
+    for (int w = 0; w < words_per_line; ++w) {
+        out[w] = presence[line * words_per_line + w];
+        any |= out[w] != 0;
+    }
+    return any;
+}
+
+void SharedLLC::clear_holders() {
+    std::fill(presence.begin(), presence.end(), 0);
+}
+
+void SharedLLC::save(CheckpointWriter& out) const {
+    out.put_vector(tags);
+    out.put_vector(states);
+    out.put_vector(ages);
+    out.put_vector(bank_free);
+    out.put_vector(bank_stats);
+    out.put(lru_counter);
+}
+
+void SharedLLC::load(CheckpointReader& in) {
+    in.get_vector(tags);
+    in.get_vector(states);
+    in.get_vector(ages);
+    in.get_vector(bank_free);
+    in.get_vector(bank_stats);
+    in.get(lru_counter);
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class CheckpointReader;
+class CheckpointWriter;
+
+// Which blocks the shared LLC keeps relative to the L1s
+enum class InclusionPolicy : uint8_t {
+    NINE,      // fills on misses and writebacks, evicts without touching the L1s
+    INCLUSIVE, // holds every block an L1 holds; evicting a block takes it out of the L1s
+    EXCLUSIVE, // victim cache: holds blocks the L1s dropped, hands them back on a hit
+};
+
+struct LLCBankStats {
+    uint64_t reads = 0;              // L1 misses no other cache supplied
+    uint64_t read_hits = 0;
+    uint64_t writes = 0;             // blocks written back (or, exclusive, dropped) by an L1
+    uint64_t evictions = 0;
+    uint64_t memory_writebacks = 0;  // dirty blocks leaving the LLC for memory
+    uint64_t back_invalidations = 0; // L1 copies removed by inclusive evictions
+    uint64_t busy_cycles = 0;        // cycles the bank spent on accesses
+    uint64_t conflict_cycles = 0;    // cycles accesses waited for their bank
+};
+
+// Block an LLC fill pushed out. With an inclusive LLC the controller must remove it from
+// the L1s; holders lists them when the LLC is the snoop directory.
+struct LLCEviction {
+    bool valid = false;
+    uint32_t block = 0;
+    std::vector<uint64_t> holders;
+};
+
+// Shared last-level cache between the bus and memory, with the L1s' block size and LRU
+// replacement. Sets are interleaved over the banks; a bank serves one access at a time,
+// each taking `latency` cycles. An inclusive LLC can also track which cores hold each of
+// its blocks and replace the snoop filter.
+class SharedLLC {
+public:
+    SharedLLC() = default;
+    SharedLLC(uint64_t size_kb, int ways, int banks, int block_bits, uint64_t latency, uint64_t memory_cycles,
+              InclusionPolicy policy, int num_cores, bool directory);
+
+    bool enabled() const { return ways > 0; }
+    bool is_directory() const { return directory; }
+    int sets() const { return num_sets; }
+
+    // An L1 miss no other cache supplied, started at cycle now. Returns the cycles until the
+    // data is ready: bank wait, LLC latency and, on a miss, memory.
+    uint64_t read(uint32_t block, uint64_t now, LLCEviction& victim);
+    // Dirty data written back by an L1; `dropped` when the L1 no longer holds the block.
+    // Returns the cycles the write takes.
+    uint64_t write_back(uint32_t block, bool dropped, uint64_t now, LLCEviction& victim);
+    // A clean block an L1 evicted (the exclusive LLC keeps it)
+    void clean_eviction(uint32_t block, LLCEviction& victim);
+    // An L1 installed block: the inclusive LLC makes sure it holds it as well
+    void filled(uint32_t block, LLCEviction& victim);
+    // Counts an L1 copy of block removed by an inclusive eviction
+    void back_invalidated(uint32_t block, bool dirty);
+
+    // Directory: per-block core presence, kept by the controller
+    void add_holder(uint32_t block, int core);
+    void remove_holder(uint32_t block, int core);
+    bool holders(uint32_t block, uint64_t* out) const;
+    int words() const { return words_per_line; }
+    void clear_holders();
+
+    std::vector<LLCBankStats> bank_stats;
+
+    void save(CheckpointWriter& out) const;
+    void load(CheckpointReader& in);
+
+private:
+    static constexpr uint8_t INVALID = 0, CLEAN = 1, DIRTY = 2;
+    static constexpr uint32_t NO_BLOCK = UINT32_MAX;
+
+    int ways = 0;
+    int num_sets = 0;
+    int num_banks = 0;
+    uint64_t latency = 0;
+    uint64_t memory_cycles = 0;
+    InclusionPolicy policy = InclusionPolicy::NINE;
+    bool directory = false;
+    int words_per_line = 0;
+    std::vector<uint32_t> tags;     // block number per line, NO_BLOCK when empty
+    std::vector<uint8_t> states;    // INVALID, CLEAN or DIRTY per line
+    std::vector<uint64_t> ages;     // LRU counter per line
+    std::vector<uint64_t> presence; // directory: words_per_line per line
+    std::vector<uint64_t> bank_free; // cycle each bank is next free
+    uint64_t lru_counter = 0;
+
+    size_t set_of(uint32_t block) const { return block & (num_sets - 1); }
+    int bank_of(uint32_t block) const { return static_cast<int>(set_of(block) & (num_banks - 1)); }
+    // Line holding block, or -1
+    long find(uint32_t block) const;
+    // Installs block (LRU victim of its set, reported in victim) and returns its line
+    size_t install(uint32_t block, uint8_t state, LLCEviction& victim);
+    void remove(size_t line);
+    // Bank wait plus latency for an access to block at cycle now
+    uint64_t occupy(uint32_t block, uint64_t now);
+};
@@ -0,0 +1,131 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+#include "L1simulate.hpp"
+#include "split_bus.hpp"
+
+Metrics::Metrics(int num_cores, uint64_t interval)
+    : interval(interval), next_sample(interval), miss_latency(num_cores), stall_cycles(num_cores),
+      stall_start(num_cores, NONE), grant_cycle(num_cores, NONE), totals(num_cores) {}
+
+void Metrics::begin(const Simulator& sim) {
+    for (size_t core = 0; core < totals.size(); ++core) {
+        const CacheStats& stats = sim.controller.l1_caches[core].stats;
+        totals[core] = {stats.total_instructions, stats.cache_misses, stats.idle_cycles};
+    }
+    prev_data_bus_cycles = sim.split_bus ? sim.split_bus->data_bus_cycles : 0;
+    prev_cycle = sim.global_cycle;
+    next_sample = sim.global_cycle + interval;
+}
+
+void Metrics::sample(const Simulator& sim) {
+    const uint64_t cycle = sim.global_cycle;
+    MetricsSample s;
+    s.cycle = cycle;
+    s.interval = cycle - prev_cycle;
+
+    uint64_t busy = busy_cycles;
+    if (sim.split_bus) {
+        busy = sim.split_bus->data_bus_cycles - prev_data_bus_cycles;
+        prev_data_bus_cycles = sim.split_bus->data_bus_cycles;
+    }
+    // Split bus transfers are counted when they start, so an interval can see a little more
+    s.bus_occupancy = s.interval ? std::min(1.0, static_cast<double>(busy) / s.interval) : 0.0;
+    busy_cycles = 0;
+
+    const int num_cores = static_cast<int>(totals.size());
+    s.cores.resize(num_cores);
+    for (int core = 0; core < num_cores; ++core) {
+        const CacheStats& stats = sim.controller.l1_caches[core].stats;
+        CoreSample& prev = totals[core];
+        s.cores[core] = {stats.total_instructions - prev.instructions, stats.cache_misses - prev.misses,
+                         stats.idle_cycles - prev.idle_cycles};
+        prev = {stats.total_instructions, stats.cache_misses, stats.idle_cycles};
+        if (stall_start[core] != NONE && grant_cycle[core] == NONE) s.queue_depth++;
+    }
+    samples.push_back(std::move(s));
+    prev_cycle = cycle;
+    next_sample = cycle + interval;
+}
+
+void Metrics::finish(const Simulator& sim) {
+    if (sim.global_cycle > prev_cycle) sample(sim);
+}
+
+static double interval_miss_rate(const CoreSample& core) {
+    return core.instructions ? (100.0 * core.misses / core.instructions) : 0.0;
+}
+
+void Metrics::write_samples_csv(std::ostream& out) const {
+    out << "cycle,interval,bus_occupancy,queue_depth,core,instructions,misses,miss_rate,idle_cycles\n";
+    for (const MetricsSample& s : samples) {
+        for (size_t core = 0; core < s.cores.size(); ++core) {
+            const CoreSample& c = s.cores[core];
+            out << s.cycle << ',' << s.interval << ',' << std::fixed << std::setprecision(4) << s.bus_occupancy << ','
+                << s.queue_depth << ',' << core << ',' << c.instructions << ',' << c.misses << ','
+                << std::setprecision(2) << interval_miss_rate(c) << ',' << c.idle_cycles << '\n';
+        }
+    }
+}
+
+static void write_histogram_rows(std::ostream& out, size_t core, const char* name, const Histogram& h) {
+    for (int b = 0; b < Histogram::BUCKETS; ++b) {
+        if (!h.counts[b]) continue;
+        out << core << ',' << name << ',' << Histogram::bucket_low(b) << ',';
+        if (b == Histogram::BUCKETS - 1) {
+            out << h.max;
+        } else {
+            out << Histogram::bucket_high(b);
+        }
+        out << ',' << h.counts[b] << '\n';
+    }
+}
+
+void Metrics::write_histograms_csv(std::ostream& out) const {
+    out << "core,histogram,low,high,count\n";
+    for (size_t core = 0; core < miss_latency.size(); ++core) {
+        write_histogram_rows(out, core, "miss_latency", miss_latency[core]);
+        write_histogram_rows(out, core, "stall_cycles", stall_cycles[core]);
+    }
+}
+
+static void write_histogram_json(std::ostream& out, const Histogram& h) {
+    double mean = h.samples ? static_cast<double>(h.sum) / h.samples : 0.0;
+    out << "{\"samples\": " << h.samples << ", \"mean\": " << std::fixed << std::setprecision(2) << mean
+        << ", \"max\": " << h.max << ", \"buckets\": [";
+    bool first = true;
+    for (int b = 0; b < Histogram::BUCKETS; ++b) {
+        if (!h.counts[b]) continue;
+        out << (first ? "" : ", ") << "[" << Histogram::bucket_low(b) << ", "
+            << (b == Histogram::BUCKETS - 1 ? h.max : Histogram::bucket_high(b)) << ", " << h.counts[b] << "]";
+        first = false;
+    }
+    out << "]}";
+}
+
+void Metrics::write_json(std::ostream& out) const {
+    out << "{\n  \"interval\": " << interval << ",\n  \"samples\": [\n";
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const MetricsSample& s = samples[i];
+        out << "    {\"cycle\": " << s.cycle << ", \"interval\": " << s.interval << ", \"bus_occupancy\": " << std::fixed
+            << std::setprecision(4) << s.bus_occupancy << ", \"queue_depth\": " << s.queue_depth << ", \"cores\": [";
+        for (size_t core = 0; core < s.cores.size(); ++core) {
+            const CoreSample& c = s.cores[core];
+            out << (core ? ", " : "") << "{\"instructions\": " << c.instructions << ", \"misses\": " << c.misses
+                << ", \"miss_rate\": " << std::setprecision(2) << interval_miss_rate(c) << ", \"idle_cycles\": "
+                << c.idle_cycles << "}";
+        }
+        out << "]}" << (i + 1 < samples.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n  \"histograms\": [\n";
+    for (size_t core = 0; core < miss_latency.size(); ++core) {
+        out << "    {\"core\": " << core << ", \"miss_latency\": ";
+        write_histogram_json(out, miss_latency[core]);
+        out << ", \"stall_cycles\": ";
+        write_histogram_json(out, stall_cycles[core]);
+        out << "}" << (core + 1 < miss_latency.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
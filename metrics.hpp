@@ -0,0 +1,98 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+class Simulator;
+
+// Histogram with power-of-two buckets: bucket 0 counts zeros, bucket k (k >= 1) counts
+// values in [2^(k-1), 2^k). The last bucket also takes everything larger.
+struct Histogram {
+    static constexpr int BUCKETS = 40;
+    uint64_t counts[BUCKETS] = {};
+    uint64_t samples = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+
+    void add(uint64_t value) {
+        int bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+        counts[bucket < BUCKETS ? bucket : BUCKETS - 1]++;
+        samples++;
+        sum += value;
+        if (value > max) max = value;
+    }
+    static uint64_t bucket_low(int bucket) { return bucket == 0 ? 0 : uint64_t{1} << (bucket - 1); }
+    static uint64_t bucket_high(int bucket) { return bucket == 0 ? 0 : (uint64_t{1} << bucket) - 1; }
+};
+
+// One core's activity over a sampling interval
+struct CoreSample {
+    uint64_t instructions = 0;
+    uint64_t misses = 0;
+    uint64_t idle_cycles = 0;
+};
+
+// State of the run over the interval ending at `cycle`
+struct MetricsSample {
+    uint64_t cycle = 0;
+    uint64_t interval = 0;     // cycles covered (the last interval may be shorter)
+    double bus_occupancy = 0;  // fraction of the interval the bus (data bus when split) was busy
+    int queue_depth = 0;       // cores waiting for the bus at the sample cycle
+    std::vector<CoreSample> cores;
+};
+
+// Time-series sampling and per-core latency histograms. The simulator only calls into it
+// from the instantiation of its loops built for instrumentation, so runs without
+// --metrics pay nothing. The hooks touch only the given core's entries, so the parallel
+// engine's workers may call them concurrently for different cores.
+class Metrics {
+public:
+    static constexpr uint64_t NONE = UINT64_MAX;
+
+    Metrics(int num_cores, uint64_t interval);
+
+    uint64_t interval;
+    uint64_t next_sample;
+    std::vector<MetricsSample> samples;
+    std::vector<Histogram> miss_latency; // per core: cycles from bus grant to the access retiring
+    std::vector<Histogram> stall_cycles; // per core: cycles from an access first stalling to it retiring
+
+    // The core's current access could not retire this cycle
+    void stalled(int core, uint64_t cycle) {
+        if (stall_start[core] == NONE) stall_start[core] = cycle;
+    }
+    // The core's current access was granted the bus
+    void granted(int core, uint64_t cycle) { grant_cycle[core] = cycle; }
+    // The core's current access retired in this cycle
+    void retired(int core, uint64_t cycle) {
+        // Also an access granted and retired in the same cycle: its grant must not carry over
+        uint64_t grant = grant_cycle[core];
+        grant_cycle[core] = NONE;
+        if (stall_start[core] == NONE) return;
+        stall_cycles[core].add(cycle - stall_start[core]);
+        if (grant != NONE) miss_latency[core].add(cycle - grant);
+        stall_start[core] = NONE;
+    }
+    void bus_busy(uint64_t cycles) { busy_cycles += cycles; }
+
+    // Starts sampling at the simulator's current cycle (later than 0 after a restore)
+    void begin(const Simulator& sim);
+    // Records the interval ending at the simulator's current cycle
+    void sample(const Simulator& sim);
+    // Records the final, possibly partial, interval
+    void finish(const Simulator& sim);
+
+    // One row per (sample, core)
+    void write_samples_csv(std::ostream& out) const;
+    // One row per (core, histogram, non-empty bucket)
+    void write_histograms_csv(std::ostream& out) const;
+    void write_json(std::ostream& out) const;
+
+private:
+    std::vector<uint64_t> stall_start;
+    std::vector<uint64_t> grant_cycle;
+    std::vector<CoreSample> totals; // cumulative counts at the previous sample
+    uint64_t busy_cycles = 0;
+    uint64_t prev_data_bus_cycles = 0;
+    uint64_t prev_cycle = 0;
+};
@@ -0,0 +1,386 @@
+#include "mrc.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+uint64_t CoreDistances::misses(int E) const {
+    uint64_t total = 0;
+    for (size_t d = E; d < reuse.size(); ++d) total += reuse[d];
+    for (uint64_t count : coherence) total += count;
+    return total;
+}
+
+uint64_t CoreDistances::coherence_misses(int E) const {
+    uint64_t total = 0;
+    for (size_t d = 0; d < static_cast<size_t>(E) && d < coherence.size(); ++d) total += coherence[d];
+    return total;
+}
+
+namespace {
+
+// The top `depth` entries of the LRU stack of every set at one set count, most recent first
+// (Mattson's stack simulation). Deeper blocks miss at every associativity reported, so they
+// are dropped. A reference searches and shifts its set's list, which for shallow stacks is
+// faster than any index.
+class ListStacks {
+public:
+    using Ref = int; // depth in the set's list, or -1 when not kept
+
+    ListStacks(int s, int depth)
+        : mask((uint32_t{1} << s) - 1), depth(depth), lines(static_cast<size_t>(depth) << s),
+          filled(size_t{1} << s, 0) {}
+
+    // below: the block is known not to be among the kept entries
+    Ref find(uint32_t block, bool below) const {
+        if (below) return -1;
+        const StackLine* set = &lines[static_cast<size_t>(block & mask) * depth];
+        const int n = filled[block & mask];
+        for (int d = 0; d < n; ++d) {
+            if (set[d].block == block) return d;
+        }
+        return -1;
+    }
+    // Depth of the block in its set's stack, or -1 below the kept entries
+    int depth_of(uint32_t, Ref d) const { return d; }
+    bool invalid(uint32_t block, Ref d) const { return lines[static_cast<size_t>(block & mask) * depth + d].invalid; }
+    void invalidate(uint32_t block, Ref d) { lines[static_cast<size_t>(block & mask) * depth + d].invalid = true; }
+
+    // Moves block from depth d (-1: not kept) to the top of its stack
+    void touch(uint32_t block, Ref d) {
+        StackLine* set = &lines[static_cast<size_t>(block & mask) * depth];
+        uint16_t& n = filled[block & mask];
+        if (d < 0) {
+            if (n < depth) n++;
+            d = n - 1;
+        }
+        for (; d > 0; --d) set[d] = set[d - 1];
+        set[0] = {block, false};
+    }
+
+private:
+    struct StackLine {
+        uint32_t block;
+        bool invalid; // another core wrote the block since
+    };
+
+    uint32_t mask;
+    int depth;
+    std::vector<StackLine> lines;
+    std::vector<uint16_t> filled; // per set
+};
+
+// Kept block -> its latest slot, open addressing with linear probing; flat, so the many
+// short-lived blocks of a large trace cost no allocation each
+class SlotTable {
+public:
+    struct Line {
+        uint32_t block;
+        uint32_t slot = EMPTY;
+        bool invalid = false; // another core wrote the block since
+    };
+
+    SlotTable() : lines(64) {}
+
+    Line* find(uint32_t block) {
+        for (size_t i = home(block);; i = (i + 1) & (lines.size() - 1)) {
+            if (lines[i].slot == EMPTY) return nullptr;
+            if (lines[i].block == block) return &lines[i];
+        }
+    }
+    // Adds a block that is not in the table
+    void insert(uint32_t block, uint32_t slot) {
+        if (2 * (size + 1) > lines.size()) grow();
+        size_t i = home(block);
+        while (lines[i].slot != EMPTY) i = (i + 1) & (lines.size() - 1);
+        lines[i] = {block, slot, false};
+        size++;
+    }
+    // Removes the entry, shifting back the ones whose probe sequence passed over it
+    void erase(Line* line) {
+        const size_t mask = lines.size() - 1;
+        size_t hole = static_cast<size_t>(line - lines.data());
+        for (size_t i = (hole + 1) & mask; lines[i].slot != EMPTY; i = (i + 1) & mask) {
+            if (((i - home(lines[i].block)) & mask) >= ((i - hole) & mask)) {
+                lines[hole] = lines[i];
+                hole = i;
+            }
+        }
+        lines[hole].slot = EMPTY;
+        size--;
+    }
+
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+    std::vector<Line> lines; // power-of-two size, at most half full
+    size_t size = 0;
+    int shift = 32 - 6;      // 32 - log2(lines.size())
+
+    // Fibonacci hashing: the top bits of the product, since the low bits of the blocks of one
+    // set are all the same
+    size_t home(uint32_t block) const { return (block * 0x9E3779B1u) >> shift; }
+    void grow() {
+        std::vector<Line> old(lines.size() * 2);
+        old.swap(lines);
+        shift--;
+        size = 0;
+        for (const Line& line : old) {
+            if (line.slot == EMPTY) continue;
+            size_t i = home(line.block);
+            while (lines[i].slot != EMPTY) i = (i + 1) & (lines.size() - 1);
+            lines[i] = line;
+            size++;
+        }
+    }
+};
+
+// The same for deep stacks, where searching and shifting a list costs O(depth) per reference:
+// each set numbers its references in a window of slots and keeps a Fenwick tree with a 1 at
+// every kept block's latest slot, so a block's depth is the number of 1s after its slot,
+// found in O(log depth). When the window fills, the set's kept blocks are renumbered from
+// slot 0 and those below the top `depth` are dropped, so each reference costs O(log depth)
+// amortised (plus a hash lookup).
+class TreeStacks {
+public:
+    using Line = SlotTable::Line;
+    using Ref = Line*; // the block's entry, or nullptr when it is not kept
+
+    TreeStacks(int s, int depth)
+        : mask((uint32_t{1} << s) - 1), depth(depth), window(2 * depth), blocks(static_cast<size_t>(window) << s),
+          tree(static_cast<size_t>(window) << s), next(size_t{1} << s, 0), kept(size_t{1} << s, 0) {}
+
+    // Looked up even below the top entries: an older slot of the block may still be counted
+    Ref find(uint32_t block, bool) { return lines.find(block); }
+    int depth_of(uint32_t block, Ref line) const {
+        if (!line) return -1;
+        const uint32_t set = block & mask;
+        int d = kept[set] - prefix(set, line->slot);
+        return d < depth ? d : -1;
+    }
+    bool invalid(uint32_t, Ref line) const { return line->invalid; }
+    void invalidate(uint32_t, Ref line) { line->invalid = true; }
+
+    void touch(uint32_t block, Ref line) {
+        const uint32_t set = block & mask;
+        uint32_t* slots = &blocks[static_cast<size_t>(set) * window];
+        if (line) {
+            slots[line->slot] = NONE;
+            add(set, line->slot, -1);
+            kept[set]--;
+        }
+        if (next[set] == static_cast<uint32_t>(window)) {
+            renumber(set);
+            line = line ? lines.find(block) : nullptr; // renumbering moves entries
+        }
+        const uint32_t slot = next[set]++;
+        slots[slot] = block;
+        add(set, slot, 1);
+        kept[set]++;
+        if (line) {
+            line->slot = slot;
+            line->invalid = false;
+        } else {
+            lines.insert(block, slot);
+        }
+    }
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX; // a slot whose block was referenced again since
+
+    uint32_t mask;
+    int depth;
+    int window;                   // slots per set
+    std::vector<uint32_t> blocks; // per set and slot: the block referenced there, or NONE
+    std::vector<uint16_t> tree;   // per set: Fenwick tree over the slots
+    std::vector<uint32_t> next;   // per set: next free slot
+    std::vector<uint16_t> kept;   // per set: blocks in the tree
+    SlotTable lines;
+
+    // Kept blocks with their latest reference in slots [0, slot]
+    int prefix(uint32_t set, uint32_t slot) const {
+        const uint16_t* t = &tree[static_cast<size_t>(set) * window];
+        int sum = 0;
+        for (uint32_t i = slot + 1; i > 0; i &= i - 1) sum += t[i - 1];
+        return sum;
+    }
+    void add(uint32_t set, uint32_t slot, int delta) {
+        uint16_t* t = &tree[static_cast<size_t>(set) * window];
+        for (uint32_t i = slot + 1; i <= static_cast<uint32_t>(window); i += i & -i) t[i - 1] += delta;
+    }
+
+    // Moves the set's top `depth` blocks to the first slots, in their order, and forgets the rest
+    void renumber(uint32_t set) {
+        uint32_t* slots = &blocks[static_cast<size_t>(set) * window];
+        int n = 0, oldest = window;
+        for (int slot = window - 1; slot >= 0; --slot) {
+            if (slots[slot] == NONE) continue;
+            if (n < depth) {
+                n++;
+                oldest = slot;
+            } else {
+                lines.erase(lines.find(slots[slot]));
+            }
+        }
+        int to = 0;
+        for (int slot = oldest; slot < window; ++slot) {
+            if (slots[slot] == NONE) continue;
+            slots[to] = slots[slot];
+            lines.find(slots[to])->slot = to;
+            to++;
+        }
+        std::fill(slots + n, slots + window, NONE);
+        // Linear-time Fenwick build over n ones
+        uint16_t* t = &tree[static_cast<size_t>(set) * window];
+        std::fill(t, t + window, 0);
+        for (int i = 1; i <= window; ++i) {
+            if (i <= n) t[i - 1]++;
+            int parent = i + (i & -i);
+            if (parent <= window) t[parent - 1] += t[i - 1];
+        }
+        next[set] = n;
+        kept[set] = static_cast<uint16_t>(n);
+    }
+};
+
+// Stacks: ListStacks or TreeStacks
+template <class Stacks>
+class Analysis {
+public:
+    Analysis(int num_cores, const std::vector<int>& s_values, int max_E)
+        : buckets(max_E + 1), stacks(num_cores) {
+        // Finest set count first: a block's depth only grows as sets merge, so once it falls
+        // out of one level's stack it is out of every coarser level's too
+        for (size_t l = 0; l < s_values.size(); ++l) order.push_back(l);
+        std::stable_sort(order.begin(), order.end(), [&](size_t x, size_t y) { return s_values[x] > s_values[y]; });
+        for (std::vector<Stacks>& core : stacks) {
+            for (size_t l : order) core.emplace_back(s_values[l], max_E);
+        }
+    }
+
+    void access(int core, uint32_t block, bool is_write, std::vector<MissRatioCurve>& curves) {
+        bool kept = true;
+        for (size_t k = 0; k < order.size(); ++k) {
+            Stacks& level = stacks[core][k];
+            CoreDistances& dist = curves[order[k]].cores[core];
+            dist.accesses++;
+            typename Stacks::Ref ref = level.find(block, !kept);
+            int d = kept ? level.depth_of(block, ref) : -1;
+            if (d < 0) {
+                kept = false;
+                dist.reuse[buckets - 1]++;
+            } else {
+                (level.invalid(block, ref) ? dist.coherence : dist.reuse)[d]++;
+            }
+            level.touch(block, ref);
+        }
+
+        // The write invalidates the other copies; they keep their place in the other stacks
+        if (!is_write) return;
+        for (size_t other = 0; other < stacks.size(); ++other) {
+            if (static_cast<int>(other) == core) continue;
+            for (Stacks& level : stacks[other]) {
+                typename Stacks::Ref ref = level.find(block, false);
+                if (level.depth_of(block, ref) < 0) break;
+                level.invalidate(block, ref);
+            }
+        }
+    }
+
+private:
+    size_t buckets;
+    std::vector<size_t> order;               // levels, finest first
+    std::vector<std::vector<Stacks>> stacks; // core -> level in that order
+};
+
+// Interleaves the cores' references round-robin through the analysis
+template <class Stacks>
+void analyse(const std::vector<TraceSource*>& sources, const std::vector<int>& s_values, int b, int max_E,
+             std::vector<MissRatioCurve>& curves) {
+    const int num_cores = static_cast<int>(sources.size());
+    Analysis<Stacks> analysis(num_cores, s_values, max_E);
+    std::vector<TraceCursor> cursors;
+    for (TraceSource* source : sources) cursors.emplace_back(source);
+    std::vector<size_t> pcs(num_cores, 0);
+    std::vector<int> running(num_cores);
+    for (int core = 0; core < num_cores; ++core) running[core] = core;
+    while (!running.empty()) {
+        size_t kept = 0;
+        for (int core : running) {
+            const TraceEntry* entry = cursors[core].at(pcs[core]);
+            if (!entry) continue;
+            pcs[core]++;
+            analysis.access(core, static_cast<uint32_t>(entry->addr) >> b, entry->op == 'W', curves);
+            running[kept++] = core;
+        }
+        running.resize(kept);
+    }
+}
+
+} // namespace
+
+std::vector<MissRatioCurve> analyse_miss_ratios(const std::vector<TraceSource*>& sources, const std::vector<int>& s_values,
+                                                int b, int max_E) {
+    const int num_cores = static_cast<int>(sources.size());
+    std::vector<MissRatioCurve> curves(s_values.size());
+    for (size_t l = 0; l < s_values.size(); ++l) {
+        curves[l].s = s_values[l];
+        curves[l].b = b;
+        curves[l].cores.resize(num_cores);
+        for (CoreDistances& dist : curves[l].cores) {
+            dist.reuse.assign(max_E + 1, 0);
+            dist.coherence.assign(max_E + 1, 0);
+        }
+    }
+
+    // Up to this depth a list search beats the tree's lookups (measured on random traces)
+    constexpr int LIST_MAX_DEPTH = 256;
+    if (max_E <= LIST_MAX_DEPTH) {
+        analyse<ListStacks>(sources, s_values, b, max_E, curves);
+    } else {
+        analyse<TreeStacks>(sources, s_values, b, max_E, curves);
+    }
+    return curves;
+}
+
+static uint64_t cache_kb(int s, int E, int b) {
+    return ((uint64_t{1} << s) * E * (uint64_t{1} << b)) / 1024;
+}
+
+static double rate(uint64_t misses, uint64_t accesses) {
+    return accesses ? (100.0 * misses / accesses) : 0.0;
+}
+
+void write_mrc_csv(const std::vector<MissRatioCurve>& curves, const std::vector<int>& E_values, std::ostream& out) {
+    out << "s,E,b,cache_kb,core,accesses,misses,miss_rate,coherence_misses\n";
+    for (const MissRatioCurve& curve : curves) {
+        for (int E : E_values) {
+            for (size_t core = 0; core < curve.cores.size(); ++core) {
+                const CoreDistances& dist = curve.cores[core];
+                uint64_t misses = dist.misses(E);
+                out << curve.s << ',' << E << ',' << curve.b << ',' << cache_kb(curve.s, E, curve.b) << ',' << core << ','
+                    << dist.accesses << ',' << misses << ',' << std::fixed << std::setprecision(2)
+                    << rate(misses, dist.accesses) << ',' << dist.coherence_misses(E) << '\n';
+            }
+        }
+    }
+}
+
+void write_mrc_json(const std::vector<MissRatioCurve>& curves, const std::vector<int>& E_values, std::ostream& out) {
+    out << "[\n";
+    size_t rows = curves.size() * E_values.size(), row = 0;
+    for (const MissRatioCurve& curve : curves) {
+        for (int E : E_values) {
+            out << "  {\"s\": " << curve.s << ", \"E\": " << E << ", \"b\": " << curve.b
+                << ", \"cache_kb\": " << cache_kb(curve.s, E, curve.b) << ",\n   \"cores\": [\n";
+            for (size_t core = 0; core < curve.cores.size(); ++core) {
+                const CoreDistances& dist = curve.cores[core];
+                uint64_t misses = dist.misses(E);
+                out << "    {\"core\": " << core << ", \"accesses\": " << dist.accesses << ", \"misses\": " << misses
+                    << ", \"miss_rate\": " << std::fixed << std::setprecision(2) << rate(misses, dist.accesses)
+                    << ", \"coherence_misses\": " << dist.coherence_misses(E) << "}"
+                    << (core + 1 < curve.cores.size() ? "," : "") << "\n";
+            }
+            out << "   ]}" << (++row < rows ? "," : "") << "\n";
+        }
+    }
+    out << "]\n";
+}
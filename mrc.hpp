@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "trace.hpp"
+
+// LRU stack distances of one core's references at one set count. A reference at depth d
+// (d other blocks of its set referenced since the last reference to it) hits in any cache of
+// that set count with more than d ways.
+struct CoreDistances {
+    uint64_t accesses = 0;
+    std::vector<uint64_t> reuse;     // reuse[d]: references at depth d; the last bucket takes deeper and first references
+    std::vector<uint64_t> coherence; // the same, for blocks another core wrote since this core's last reference
+
+    // Misses of an E-way cache: deeper than E, and every reference to an invalidated block
+    uint64_t misses(int E) const;
+    // References to an invalidated block that would have hit otherwise
+    uint64_t coherence_misses(int E) const;
+};
+
+// Stack distances of every core at 2^s sets of 2^b bytes
+struct MissRatioCurve {
+    int s = 0;
+    int b = 0;
+    std::vector<CoreDistances> cores;
+};
+
+// One pass over the traces computes the distances at every set count in s_values, up to
+// max_E ways. The cores' references are interleaved round-robin, one per core in turn.
+std::vector<MissRatioCurve> analyse_miss_ratios(const std::vector<TraceSource*>& sources, const std::vector<int>& s_values,
+                                                int b, int max_E);
+
+// One row per (s, E, b, core)
+void write_mrc_csv(const std::vector<MissRatioCurve>& curves, const std::vector<int>& E_values, std::ostream& out);
+// One object per (s, E, b) with a per-core array
+void write_mrc_json(const std::vector<MissRatioCurve>& curves, const std::vector<int>& E_values, std::ostream& out);
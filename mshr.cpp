@@ -0,0 +1,67 @@
+#include "mshr.hpp"
+
+#include <algorithm>
+
+#include "checkpoint.hpp"
+
+MissHandler::Entry* MissHandler::find(uint32_t block) {
+    for (Entry& entry : entries) {
+        if (entry.block == block) return &entry;
+    }
+    return nullptr;
+}
+
+void MissHandler::allocate(uint32_t block, uint32_t addr, bool write) {
+    entries.push_back({block, addr, write, 0});
+    stats.primary_misses++;
+}
+
+MissHandler::Entry MissHandler::release(uint32_t block) {
+    auto it = std::find_if(entries.begin(), entries.end(), [&](const Entry& e) { return e.block == block; });
+    Entry entry = *it;
+    entries.erase(it);
+    return entry;
+}
+
+bool MissHandler::forwards(uint32_t addr) const {
+    return std::find(store_buffer.begin(), store_buffer.end(), addr) != store_buffer.end();
+}
+
+void MissHandler::tick() {
+    if (entries.empty()) return;
+    stats.occupancy += entries.size();
+    stats.busy_cycles++;
+    stats.max_in_use = std::max<uint64_t>(stats.max_in_use, entries.size());
+}
+
+// Entries are written field by field: the padding after `write` is not initialised
+void MissHandler::save(CheckpointWriter& out) const {
+    out.put<uint64_t>(entries.size());
+    for (const Entry& entry : entries) {
+        out.put(entry.block);
+        out.put(entry.addr);
+        out.put(entry.write);
+        out.put(entry.merged);
+    }
+    out.put_vector(std::vector<uint32_t>(store_buffer.begin(), store_buffer.end()));
+    out.put(stats);
+}
+
+const char* MissHandler::load(CheckpointReader& in) {
+    uint64_t count = 0;
+    if (!in.get(count)) return "truncated or corrupt checkpoint";
+    if (count > static_cast<uint64_t>(mshrs)) return "more MSHRs in use than --mshrs allows";
+    entries.assign(count, Entry{});
+    for (Entry& entry : entries) {
+        in.get(entry.block);
+        in.get(entry.addr);
+        in.get(entry.write);
+        in.get(entry.merged);
+    }
+    std::vector<uint32_t> stores;
+    if (!in.get_vector(stores)) return "truncated or corrupt checkpoint";
+    if (stores.size() > static_cast<size_t>(store_buffer_size)) return "more buffered stores than --store-buffer allows";
+    store_buffer.assign(stores.begin(), stores.end());
+    in.get(stats);
+    return nullptr;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+class CheckpointReader;
+class CheckpointWriter;
+
+struct MissHandlerStats {
+    uint64_t primary_misses = 0;     // misses that allocated an MSHR
+    uint64_t merged_misses = 0;      // loads merged into the MSHR already fetching their block
+    uint64_t occupancy = 0;          // sum over cycles of the MSHRs in use
+    uint64_t busy_cycles = 0;        // cycles with at least one MSHR in use
+    uint64_t max_in_use = 0;
+    uint64_t mshr_full_cycles = 0;   // cycles the core stalled for a free MSHR
+    uint64_t buffered_stores = 0;    // stores retired into the store buffer
+    uint64_t forwarded_loads = 0;    // loads served from a buffered store to the same address
+    uint64_t buffer_full_cycles = 0; // cycles the core stalled on a full store buffer
+};
+
+// Miss status holding registers and store buffer of one non-blocking L1. A load miss takes
+// an MSHR and the core moves on; later loads of the same block wait in that MSHR instead of
+// sending another request. Stores retire into the store buffer, which performs them in
+// order, taking an MSHR whenever its oldest store needs ownership of its block.
+class MissHandler {
+public:
+    struct Entry {
+        uint32_t block;
+        uint32_t addr;   // access that allocated it; the bus request carries this address
+        bool write;      // fetches ownership for the oldest buffered store
+        uint32_t merged; // loads waiting on the block besides the one that allocated it
+    };
+    static constexpr uint32_t MAX_MERGED = 8; // further loads of the block stall the core
+
+    MissHandler(int mshrs, int store_buffer_size) : mshrs(mshrs), store_buffer_size(store_buffer_size) {}
+
+    Entry* find(uint32_t block);
+    bool mshr_free() const { return static_cast<int>(entries.size()) < mshrs; }
+    void allocate(uint32_t block, uint32_t addr, bool write);
+    // Frees the block's MSHR and returns it
+    Entry release(uint32_t block);
+
+    bool buffer_full() const { return store_buffer.size() >= static_cast<size_t>(store_buffer_size); }
+    // A buffered store to addr can supply a load
+    bool forwards(uint32_t addr) const;
+
+    bool idle() const { return entries.empty() && store_buffer.empty(); }
+    // Accounts one cycle of MSHR occupancy
+    void tick();
+
+    std::deque<uint32_t> store_buffer; // addresses of retired stores not yet performed, oldest first
+    MissHandlerStats stats;
+
+    void save(CheckpointWriter& out) const;
+    // Returns why the saved state cannot be this L1's, or nullptr once it is restored
+    const char* load(CheckpointReader& in);
+
+private:
+    int mshrs;
+    int store_buffer_size;
+    std::vector<Entry> entries; // MSHRs in use
+};
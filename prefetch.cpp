@@ -0,0 +1,91 @@
+#include "prefetch.hpp"
+
+#include <cstdlib>
+
+#include "checkpoint.hpp"
+
+// Appends block + step * k for k = 1..count while it stays a valid block number
+static void predict(int64_t block, int64_t step, int count, std::vector<uint32_t>& out) {
+    for (int k = 1; k <= count; ++k) {
+        int64_t next = block + step * k;
+        if (next < 0 || next > UINT32_MAX) return;
+        out.push_back(static_cast<uint32_t>(next));
+    }
+}
+
+void NextLinePrefetcher::train(uint32_t block, std::vector<uint32_t>& out) {
+    predict(block, 1, degree, out);
+}
+
+void StridePrefetcher::train(uint32_t block, std::vector<uint32_t>& out) {
+    int64_t stride = static_cast<int64_t>(block) - state.last;
+    if (state.started && stride != 0) {
+        if (stride == state.stride) {
+            if (state.confidence < 2) state.confidence++;
+        } else {
+            state.stride = stride;
+            state.confidence = 0;
+        }
+    }
+    state.last = block;
+    state.started = true;
+    if (state.confidence >= 1) predict(block, state.stride, degree, out);
+}
+
+void StridePrefetcher::save(CheckpointWriter& out) const {
+    out.put(state);
+}
+
+void StridePrefetcher::load(CheckpointReader& in) {
+    in.get(state);
+}
+
+void StreamPrefetcher::train(uint32_t block, std::vector<uint32_t>& out) {
+    Stream* stream = nullptr;
+    for (Stream& s : streams) {
+        if (s.lru && std::llabs(static_cast<int64_t>(block) - s.last) <= WINDOW) {
+            stream = &s;
+            break;
+        }
+    }
+    if (!stream) {
+        // Start a new stream in the least recently used entry
+        stream = &streams[0];
+        for (Stream& s : streams) {
+            if (s.lru < stream->lru) stream = &s;
+        }
+        *stream = Stream{block, 0, 0, ++lru_counter};
+        return;
+    }
+    stream->lru = ++lru_counter;
+    if (block == stream->last) return;
+    int direction = block > stream->last ? 1 : -1;
+    if (direction == stream->direction) {
+        if (stream->confidence < 2) stream->confidence++;
+    } else {
+        stream->direction = direction;
+        stream->confidence = 1;
+    }
+    stream->last = block;
+    if (stream->confidence >= 2) predict(block, direction, degree, out);
+}
+
+void StreamPrefetcher::save(CheckpointWriter& out) const {
+    out.put_vector(streams);
+    out.put(lru_counter);
+}
+
+void StreamPrefetcher::load(CheckpointReader& in) {
+    in.get_vector(streams);
+    in.get(lru_counter);
+}
+
+std::unique_ptr<Prefetcher> make_prefetcher(PrefetchKind kind, int degree) {
+    switch (kind) {
+    case PrefetchKind::NEXT_LINE: return std::make_unique<NextLinePrefetcher>(degree);
+    case PrefetchKind::STRIDE: return std::make_unique<StridePrefetcher>(degree);
+    case PrefetchKind::STREAM: return std::make_unique<StreamPrefetcher>(degree);
+    case PrefetchKind::NONE: break;
+    }
+    return nullptr;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+class CheckpointReader;
+class CheckpointWriter;
+
+enum class PrefetchKind : uint8_t { NONE, NEXT_LINE, STRIDE, STREAM };
+
+// Predicts the blocks (addresses >> b) a core is about to miss on. It is trained on the
+// core's demand misses and on its first use of each prefetched block, so a covered stream
+// keeps running ahead of the core.
+class Prefetcher {
+public:
+    explicit Prefetcher(int degree) : degree(degree) {}
+    virtual ~Prefetcher() = default;
+
+    // Appends up to `degree` predicted blocks to out
+    virtual void train(uint32_t block, std::vector<uint32_t>& out) = 0;
+
+    virtual void save(CheckpointWriter& out) const = 0;
+    virtual void load(CheckpointReader& in) = 0;
+
+protected:
+    int degree;
+};
+
+// The next `degree` blocks after every trained block
+class NextLinePrefetcher : public Prefetcher {
+public:
+    using Prefetcher::Prefetcher;
+    void train(uint32_t block, std::vector<uint32_t>& out) override;
+    void save(CheckpointWriter&) const override {}
+    void load(CheckpointReader&) override {}
+};
+
+// One stride detector for the whole core (the traces carry no PCs): once the same distance
+// separates three trained blocks in a row, `degree` blocks further along it are predicted
+class StridePrefetcher : public Prefetcher {
+public:
+    using Prefetcher::Prefetcher;
+    void train(uint32_t block, std::vector<uint32_t>& out) override;
+    void save(CheckpointWriter& out) const override;
+    void load(CheckpointReader& in) override;
+
+private:
+    struct State {
+        uint32_t last = 0;
+        int64_t stride = 0;
+        int confidence = 0;
+        bool started = false;
+    } state;
+};
+
+// Tracks up to STREAMS regions the core walks through, each with the last block trained in
+// it and its direction. A block within WINDOW blocks of a stream joins it; after two steps
+// in the same direction the next `degree` blocks in that direction are predicted. Unlike
+// the stride detector it tolerates uneven steps and interleaved streams.
+class StreamPrefetcher : public Prefetcher {
+public:
+    static constexpr int STREAMS = 16;
+    static constexpr int64_t WINDOW = 16;
+
+    explicit StreamPrefetcher(int degree) : Prefetcher(degree), streams(STREAMS) {}
+    void train(uint32_t block, std::vector<uint32_t>& out) override;
+    void save(CheckpointWriter& out) const override;
+    void load(CheckpointReader& in) override;
+
+private:
+    struct Stream {
+        uint32_t last = 0;
+        int direction = 0; // +1, -1, or 0 until the second block
+        int confidence = 0;
+        uint64_t lru = 0;  // 0 = unused entry
+    };
+    std::vector<Stream> streams;
+    uint64_t lru_counter = 0;
+};
+
+std::unique_ptr<Prefetcher> make_prefetcher(PrefetchKind kind, int degree);
+
+// A core's prefetcher with the blocks it predicted that are still waiting for a free bus
+struct PrefetchUnit {
+    static constexpr size_t QUEUE_DEPTH = 16; // further predictions are dropped
+
+    std::unique_ptr<Prefetcher> prefetcher;
+    std::deque<uint32_t> queue;
+    std::vector<uint32_t> scratch;
+};
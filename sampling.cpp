@@ -0,0 +1,274 @@
+#include "sampling.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+bool PhaseSource::fetch(size_t idx, TraceWindow& window) {
+    if (idx >= end) return false;
+    if (!inner->fetch(idx, window)) {
+        exhausted = true;
+        return false;
+    }
+    if (window.start + window.len > end) {
+        window.len = end - window.start;
+        window.last = true;
+    }
+    return true;
+}
+
+Sampler::Sampler(const SimConfig& config, const std::vector<TraceSource*>& sources)
+    : period(config.sampling_period), warmup(config.sampling_warmup), detail(config.sampling_detail),
+      reads(config.num_cores), writes(config.num_cores) {
+    phases.reserve(config.num_cores);
+    for (int i = 0; i < config.num_cores; ++i) phases.emplace_back(sources[i]);
+}
+
+// The core took part in a window (it may have been stalled throughout)
+static bool ran(const CacheStats& delta) {
+    return delta.total_instructions || delta.total_cycles || delta.idle_cycles;
+}
+
+void Sampler::set_end(int core, size_t end) {
+    phases[core].end = end;
+}
+
+// Accesses the fastest core runs per turn of the functional phase
+constexpr size_t WARM_CHUNK = 32;
+
+bool Sampler::warm(Simulator& sim) {
+    const int num_cores = static_cast<int>(phases.size());
+    std::vector<int> running;
+    std::vector<size_t> start(num_cores), quota(num_cores);
+    size_t longest = 0;
+    for (int core = 0; core < num_cores; ++core) {
+        start[core] = sim.cores[core].pc;
+        quota[core] = phases[core].end - start[core];
+        longest = std::max(longest, quota[core]);
+        if (!phases[core].exhausted && quota[core]) running.push_back(core);
+    }
+    // In each turn every core catches up to its share of its quota, so the cores stay
+    // interleaved at their relative rates
+    const size_t turns = (longest + WARM_CHUNK - 1) / WARM_CHUNK;
+    for (size_t turn = 1; !running.empty(); ++turn) {
+        size_t kept = 0;
+        for (int core : running) {
+            CoreState& state = sim.cores[core];
+            size_t goal = start[core] + (turn >= turns ? quota[core] : quota[core] * turn / turns);
+            size_t first = state.pc;
+            uint64_t stores = sim.run_functional(core, goal);
+            writes[core] += stores;
+            reads[core] += state.pc - first - stores;
+            functional_accesses += state.pc - first;
+            if (state.pc == goal && goal < phases[core].end) running[kept++] = core;
+        }
+        running.resize(kept);
+    }
+    return std::any_of(phases.begin(), phases.end(), [](const PhaseSource& phase) { return !phase.exhausted; });
+}
+
+void Sampler::simulate(Simulator& sim, uint64_t cycles) {
+    sim.active_cores = 0;
+    uint64_t start = 0;
+    for (size_t core = 0; core < phases.size(); ++core) {
+        phases[core].end = SIZE_MAX;
+        CoreState& state = sim.cores[core];
+        state.done = phases[core].exhausted;
+        if (!state.done) sim.active_cores++;
+        start += state.pc;
+    }
+    if (sim.active_cores == 0) return;
+    sim.stop_cycle = sim.global_cycle + cycles;
+    sim.simulate();
+    sim.stop_cycle = UINT64_MAX;
+    for (const CoreState& state : sim.cores) detailed_accesses += state.pc;
+    detailed_accesses -= start;
+}
+
+void Sampler::run(Simulator& sim) {
+    const int num_cores = static_cast<int>(phases.size());
+    const CacheController& controller = sim.controller;
+    const uint64_t gap = period - warmup - detail;
+    for (;;) {
+        if (warmup) simulate(sim, warmup);
+
+        Window before;
+        for (const L1Cache& cache : controller.l1_caches) before.cores.push_back(cache.stats);
+        before.bus_transactions = controller.total_bus_transactions;
+        before.bus_traffic_bytes = controller.total_bus_traffic_bytes;
+        before.cycles = sim.global_cycle;
+        simulate(sim, detail);
+
+        Window window;
+        window.cores.resize(num_cores);
+        bool measured = false;
+        uint64_t retired = 0;
+        for (int core = 0; core < num_cores; ++core) {
+            const CacheStats& now = controller.l1_caches[core].stats;
+            const CacheStats& prev = before.cores[core];
+            CacheStats& delta = window.cores[core];
+            delta.total_instructions = now.total_instructions - prev.total_instructions;
+            delta.total_reads = now.total_reads - prev.total_reads;
+            delta.total_writes = now.total_writes - prev.total_writes;
+            delta.total_cycles = now.total_cycles - prev.total_cycles;
+            delta.idle_cycles = now.idle_cycles - prev.idle_cycles;
+            delta.cache_misses = now.cache_misses - prev.cache_misses;
+            delta.cache_evictions = now.cache_evictions - prev.cache_evictions;
+            delta.writebacks = now.writebacks - prev.writebacks;
+            delta.bus_invalidations = now.bus_invalidations - prev.bus_invalidations;
+            delta.data_traffic_bytes = now.data_traffic_bytes - prev.data_traffic_bytes;
+            if (ran(delta)) measured = true;
+            retired += delta.total_instructions;
+        }
+        window.bus_transactions = controller.total_bus_transactions - before.bus_transactions;
+        window.bus_traffic_bytes = controller.total_bus_traffic_bytes - before.bus_traffic_bytes;
+        window.cycles = sim.global_cycle - before.cycles;
+        if (!measured) break; // every trace has ended
+        windows.push_back(window);
+        // With every core stalled the gap would run nothing; stay in detail so the
+        // transaction on the bus can finish
+        if (gap == 0 || retired == 0) continue;
+
+        // Skip ahead: each core runs functionally the accesses it would retire in `gap` cycles
+        // at its rate in the window. A transaction still on the bus is dropped; its access has
+        // not retired, so the functional phase performs it again.
+        sim.bus = Bus{};
+        for (int core = 0; core < num_cores; ++core) {
+            double rate = static_cast<double>(window.cores[core].total_instructions) / window.cycles;
+            set_end(core, sim.cores[core].pc + static_cast<size_t>(std::llround(gap * rate)));
+        }
+        if (!warm(sim)) break;
+    }
+    extrapolate(sim);
+}
+
+static constexpr double T_95_TABLE[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                        2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                        2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+
+// Two-sided 95% quantile of Student's t distribution with df degrees of freedom
+static constexpr double t_95(uint64_t df) {
+    if (df == 0) return 0.0;
+    return df <= 30 ? T_95_TABLE[df - 1] : 1.960;
+}
+
+// The table is checked at compile time against the distribution itself: for integer df,
+// P(|T| < t) has a closed form in theta = atan(t / sqrt(df)) (Abramowitz & Stegun 26.7.3-4),
+// which must come to 0.95 at every tabulated quantile.
+static constexpr double const_sqrt(double x) {
+    double r = x < 1 ? 1 : x;
+    for (int i = 0; i < 64; ++i) r = (r + x / r) / 2;
+    return r;
+}
+
+static constexpr double const_atan(double x) {
+    // atan(x) = 2 atan(x / (1 + sqrt(1 + x^2))); four halvings bring x below 0.1 for the series
+    for (int i = 0; i < 4; ++i) x = x / (1 + const_sqrt(1 + x * x));
+    double sum = 0, power = x;
+    for (int k = 1; k < 40; k += 2, power *= -x * x) sum += power / k;
+    return 16 * sum;
+}
+
+static constexpr double t_coverage(double t, int df) {
+    const double pi = 3.14159265358979323846;
+    const double cos2 = df / (df + t * t);
+    const double sin = t / const_sqrt(df + t * t);
+    if (df % 2 == 0) {
+        double sum = 1, term = 1;
+        for (int k = 2; k <= df - 2; k += 2) sum += term *= cos2 * (k - 1) / k;
+        return sin * sum;
+    }
+    double theta = const_atan(t / const_sqrt(df));
+    double sum = 0, term = const_sqrt(cos2);
+    if (df > 1) sum = term;
+    for (int k = 3; k <= df - 2; k += 2) sum += term *= cos2 * (k - 1) / k;
+    return 2 / pi * (theta + sin * sum);
+}
+
+static constexpr bool t_95_table_ok() {
+    for (int df = 1; df <= 30; ++df) {
+        double coverage = t_coverage(T_95_TABLE[df - 1], df);
+        if (coverage < 0.9999 * 0.95 || coverage > 1.0001 * 0.95) return false;
+    }
+    return true;
+}
+static_assert(t_95_table_ok(), "T_95_TABLE must hold the two-sided 95% quantiles of Student's t");
+
+// Ratio estimate sum(y) / sum(n) over the windows, scaled by total, with its 95% confidence
+// interval (zero with fewer than two windows)
+static Estimate ratio_estimate(const std::vector<double>& y, const std::vector<double>& n, double total) {
+    Estimate e;
+    const size_t k = y.size();
+    double sum_y = 0, sum_n = 0;
+    for (size_t j = 0; j < k; ++j) {
+        sum_y += y[j];
+        sum_n += n[j];
+    }
+    if (sum_n == 0) return e;
+    double rate = sum_y / sum_n;
+    e.value = rate * total;
+    if (k < 2) return e;
+    double residual = 0;
+    for (size_t j = 0; j < k; ++j) residual += (y[j] - rate * n[j]) * (y[j] - rate * n[j]);
+    double mean_n = sum_n / k;
+    double se = std::sqrt(residual / (k * (k - 1.0))) / mean_n;
+    e.ci = t_95(k - 1) * se * total;
+    return e;
+}
+
+void Sampler::extrapolate(Simulator& sim) {
+    CacheController& controller = sim.controller;
+    const int num_cores = static_cast<int>(phases.size());
+    estimates.assign(num_cores, CoreEstimate{});
+
+    static constexpr uint64_t CacheStats::*scaled[] = {
+        &CacheStats::total_cycles, &CacheStats::idle_cycles,       &CacheStats::cache_misses,
+        &CacheStats::cache_evictions, &CacheStats::writebacks, &CacheStats::bus_invalidations,
+        &CacheStats::data_traffic_bytes};
+
+    double all_accesses = 0;
+    for (int core = 0; core < num_cores; ++core) {
+        CacheStats& stats = controller.l1_caches[core].stats;
+        CoreEstimate& est = estimates[core];
+        const double total = static_cast<double>(sim.cores[core].pc);
+        all_accesses += total;
+
+        std::vector<double> n;
+        for (const Window& w : windows) {
+            if (ran(w.cores[core])) n.push_back(static_cast<double>(w.cores[core].total_instructions));
+        }
+        est.windows = n.size();
+        for (double count : n) est.measured += static_cast<uint64_t>(count);
+
+        CacheStats result;
+        result.total_instructions = sim.cores[core].pc;
+        result.total_reads = stats.total_reads + reads[core];
+        result.total_writes = stats.total_writes + writes[core];
+        for (auto field : scaled) {
+            std::vector<double> y;
+            for (const Window& w : windows) {
+                if (ran(w.cores[core])) y.push_back(static_cast<double>(w.cores[core].*field));
+            }
+            Estimate e = ratio_estimate(y, n, total);
+            result.*field = std::llround(e.value);
+            if (field == &CacheStats::total_cycles) est.total_cycles = e;
+            if (field == &CacheStats::idle_cycles) est.idle_cycles = e;
+            if (field == &CacheStats::cache_misses && total > 0) {
+                est.miss_rate = {100.0 * e.value / total, 100.0 * e.ci / total};
+            }
+        }
+        stats = result;
+    }
+
+    std::vector<double> n, transactions, traffic, cycles;
+    for (const Window& w : windows) {
+        uint64_t accesses = 0;
+        for (const CacheStats& core : w.cores) accesses += core.total_instructions;
+        n.push_back(static_cast<double>(accesses));
+        transactions.push_back(static_cast<double>(w.bus_transactions));
+        traffic.push_back(static_cast<double>(w.bus_traffic_bytes));
+        cycles.push_back(static_cast<double>(w.cycles));
+    }
+    controller.total_bus_transactions = std::llround(ratio_estimate(transactions, n, all_accesses).value);
+    controller.total_bus_traffic_bytes = std::llround(ratio_estimate(traffic, n, all_accesses).value);
+    sim.global_cycle = std::llround(ratio_estimate(cycles, n, all_accesses).value);
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "L1simulate.hpp"
+
+// Records [0, end) of another trace source. The sampler moves `end` forward one phase at a
+// time, so the cycle loops see each phase as a trace of its own and stop at its end.
+class PhaseSource : public TraceSource {
+public:
+    explicit PhaseSource(TraceSource* inner) : inner(inner) {}
+
+    bool fetch(size_t idx, TraceWindow& window) override;
+
+    size_t end = 0;
+    bool exhausted = false; // the underlying trace ended before `end`
+
+private:
+    TraceSource* inner;
+};
+
+// Extrapolated whole-run value of a statistic and the half-width of its 95% confidence interval
+struct Estimate {
+    double value = 0;
+    double ci = 0;
+};
+
+// Sampling results for one core
+struct CoreEstimate {
+    uint64_t windows = 0;  // measured windows
+    uint64_t measured = 0; // accesses in them
+    Estimate total_cycles;
+    Estimate idle_cycles;
+    Estimate miss_rate;    // percent of accesses
+};
+
+// Statistical sampling (SMARTS-style systematic sampling). The run is cut into periods of
+// sampling_period cycles. Each period starts with sampling_warmup + sampling_detail cycles of
+// the cycle-level model with the configured engine, of which only the last sampling_detail are
+// measured. For the rest of the period every core runs functionally: each access updates tags,
+// MESI states and LRU order at once, with no bus timing. The measured per-access rates are
+// then scaled to the whole trace.
+//
+// Windows are bounded in cycles rather than accesses because the cores do not run at the same
+// speed (the bus favours low core numbers), and which core touches a shared block first depends
+// on how far apart they are. So the functional part advances each core by the accesses it would
+// retire in the skipped cycles at its rate in the last window, interleaving the cores in
+// proportion. A transaction still on the bus when a window ends is dropped and its access
+// performed again functionally.
+class Sampler {
+public:
+    Sampler(const SimConfig& config, const std::vector<TraceSource*>& sources);
+
+    TraceSource* source(int core) { return &phases[core]; }
+
+    // Runs the whole trace and replaces the simulator's statistics with the estimates
+    void run(Simulator& sim);
+
+    std::vector<CoreEstimate> estimates;
+    uint64_t functional_accesses = 0;
+    uint64_t detailed_accesses = 0;
+
+private:
+    // Counts over one measured window
+    struct Window {
+        std::vector<CacheStats> cores;
+        uint64_t bus_transactions = 0;
+        uint64_t bus_traffic_bytes = 0;
+        uint64_t cycles = 0;
+    };
+
+    uint64_t period;
+    uint64_t warmup;
+    uint64_t detail;
+    std::vector<PhaseSource> phases;
+    std::vector<Window> windows;
+    std::vector<uint64_t> reads;  // per core, accesses run functionally
+    std::vector<uint64_t> writes;
+
+    void set_end(int core, size_t end);
+    // Runs every core functionally up to the current phase end; false once all traces ended
+    bool warm(Simulator& sim);
+    // Runs the cycle-level model for the given number of cycles
+    void simulate(Simulator& sim, uint64_t cycles);
+    void extrapolate(Simulator& sim);
+};
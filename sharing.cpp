@@ -0,0 +1,116 @@
+#include "sharing.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+#include "L1simulate.hpp"
+
+SharingProfiler::SharingProfiler(int num_cores, int block_bits, int top)
+    : num_cores(num_cores), block_bits(block_bits), top(top) {}
+
+SharingPair& SharingProfiler::pair(uint32_t block, int requester, int holder) {
+    BlockSharing& entry = blocks[block];
+    entry.block = block;
+    for (SharingPair& p : entry.pairs) {
+        if (p.requester == requester && p.holder == holder) return p;
+    }
+    entry.pairs.push_back({requester, holder});
+    return entry.pairs.back();
+}
+
+void SharingProfiler::invalidated(uint32_t block, int requester, int holder, bool modified) {
+    SharingPair& p = pair(block, requester, holder);
+    BlockSharing& entry = blocks[block];
+    p.invalidations++;
+    entry.invalidations++;
+    if (modified) {
+        p.m_to_i++;
+        entry.m_to_i++;
+    }
+}
+
+void SharingProfiler::downgraded(uint32_t block, int requester, int holder) {
+    pair(block, requester, holder).m_to_s++;
+    blocks[block].m_to_s++;
+}
+
+void SharingProfiler::finish(std::vector<CoreState>& cores) {
+    hottest.clear();
+    for (const auto& [block, entry] : blocks) hottest.push_back(entry);
+    auto hotter = [](const BlockSharing& x, const BlockSharing& y) {
+        return x.events() != y.events() ? x.events() > y.events() : x.block < y.block;
+    };
+    size_t n = std::min(top, hottest.size());
+    std::partial_sort(hottest.begin(), hottest.begin() + n, hottest.end(), hotter);
+    hottest.resize(n);
+
+    std::unordered_map<uint32_t, BlockSharing*> reported;
+    const size_t block_size = size_t{1} << block_bits;
+    for (BlockSharing& entry : hottest) {
+        entry.touched.assign(num_cores, std::vector<uint8_t>(block_size, 0));
+        reported[entry.block] = &entry;
+    }
+    for (int core = 0; core < num_cores; ++core) {
+        TraceCursor cursor = cores[core].cursor;
+        const TraceEntry* entry;
+        for (size_t idx = 0; (entry = cursor.at(idx)); ++idx) {
+            uint32_t addr = static_cast<uint32_t>(entry->addr);
+            auto found = reported.find(addr >> block_bits);
+            if (found == reported.end()) continue;
+            found->second->touched[core][addr & (block_size - 1)] |= entry->op == 'W' ? TOUCHED_WRITE : TOUCHED_READ;
+        }
+    }
+
+    for (BlockSharing& entry : hottest) {
+        for (size_t offset = 0; offset < block_size && !entry.true_sharing; ++offset) {
+            int writers = 0, users = 0;
+            for (int core = 0; core < num_cores; ++core) {
+                uint8_t bits = entry.touched[core][offset];
+                writers += (bits & TOUCHED_WRITE) != 0;
+                users += bits != 0;
+            }
+            entry.true_sharing = writers > 0 && users > 1;
+        }
+    }
+}
+
+// "0-3,8,12-15" for the offsets with any of the given bits
+static void write_offsets(std::ostream& out, const std::vector<uint8_t>& touched, uint8_t bits) {
+    bool first = true;
+    for (size_t lo = 0; lo < touched.size(); ++lo) {
+        if (!(touched[lo] & bits)) continue;
+        size_t hi = lo;
+        while (hi + 1 < touched.size() && (touched[hi + 1] & bits)) hi++;
+        out << (first ? "" : ",") << lo;
+        if (hi > lo) out << '-' << hi;
+        first = false;
+        lo = hi;
+    }
+    if (first) out << "none";
+}
+
+void SharingProfiler::write(std::ostream& out) const {
+    out << "\nSharing Profile (top " << hottest.size() << " blocks by invalidations + M->S transfers):\n";
+    for (const BlockSharing& entry : hottest) {
+        out << "Block 0x" << std::hex << std::setw(8) << std::setfill('0') << (entry.block << block_bits) << std::dec
+            << std::setfill(' ') << ": " << entry.invalidations << " invalidations, " << entry.m_to_s << " M->S, "
+            << entry.m_to_i << " M->I, " << (entry.true_sharing ? "true sharing" : "false sharing") << "\n";
+        std::vector<SharingPair> pairs = entry.pairs;
+        std::sort(pairs.begin(), pairs.end(), [](const SharingPair& x, const SharingPair& y) {
+            return x.requester != y.requester ? x.requester < y.requester : x.holder < y.holder;
+        });
+        for (const SharingPair& p : pairs) {
+            out << "  Core " << p.requester << " from Core " << p.holder << ": " << p.invalidations << " invalidations, "
+                << p.m_to_s << " M->S, " << p.m_to_i << " M->I\n";
+        }
+        for (int core = 0; core < num_cores; ++core) {
+            const std::vector<uint8_t>& touched = entry.touched[core];
+            if (std::none_of(touched.begin(), touched.end(), [](uint8_t bits) { return bits != 0; })) continue;
+            out << "  Core " << core << " bytes read ";
+            write_offsets(out, touched, TOUCHED_READ);
+            out << ", written ";
+            write_offsets(out, touched, TOUCHED_WRITE);
+            out << "\n";
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+struct CoreState;
+
+// Coherence traffic on one block from one core's copy to another core's request
+struct SharingPair {
+    int requester = 0;
+    int holder = 0;
+    uint64_t invalidations = 0; // holder's copy invalidated by the requester's write or upgrade
+    uint64_t m_to_s = 0;        // holder's modified copy supplied to the requester's read
+    uint64_t m_to_i = 0;        // holder's modified copy taken by the requester's write
+};
+
+struct BlockSharing {
+    uint32_t block = 0; // address >> b
+    uint64_t invalidations = 0;
+    uint64_t m_to_s = 0;
+    uint64_t m_to_i = 0;
+    std::vector<SharingPair> pairs;
+    // Reported blocks only: per core, one entry per byte of the block with TOUCHED_* bits
+    std::vector<std::vector<uint8_t>> touched;
+    bool true_sharing = false; // some core accessed a byte another core wrote
+
+    uint64_t events() const { return invalidations + m_to_s; }
+};
+
+// Profiles which blocks move between the caches and why. The controller reports every
+// invalidation and modified-to-shared downgrade of another core's copy; at the end of the
+// run the hottest blocks get one pass over the traces recording the byte offsets each core
+// read and wrote, which tells true sharing (the cores use the same bytes) from false sharing
+// (they use different bytes of the same block).
+class SharingProfiler {
+public:
+    static constexpr uint8_t TOUCHED_READ = 1;
+    static constexpr uint8_t TOUCHED_WRITE = 2;
+
+    SharingProfiler(int num_cores, int block_bits, int top);
+
+    void invalidated(uint32_t block, int requester, int holder, bool modified);
+    void downgraded(uint32_t block, int requester, int holder);
+
+    // Picks the hottest blocks and records their byte offsets from the cores' traces, read
+    // again from the start (the sources must support it)
+    void finish(std::vector<CoreState>& cores);
+
+    std::vector<BlockSharing> hottest;
+    void write(std::ostream& out) const;
+
+private:
+    int num_cores;
+    int block_bits;
+    size_t top;
+    std::unordered_map<uint32_t, BlockSharing> blocks;
+
+    SharingPair& pair(uint32_t block, int requester, int holder);
+};
@@ -0,0 +1,41 @@
+#include "snoop_filter.hpp"
+
+SnoopFilter::SnoopFilter(int num_cores) : words_per_entry((num_cores + 63) / 64) {}
+
+void SnoopFilter::add(uint32_t block, int core) {
+    auto it = slot_of.find(block);
+    uint32_t slot;
+    if (it != slot_of.end()) {
+        slot = it->second;
+    } else {
+        if (!free_slots.empty()) {
+            slot = free_slots.back();
+            free_slots.pop_back();
+        } else {
+            slot = static_cast<uint32_t>(bits.size() / words_per_entry);
+            bits.resize(bits.size() + words_per_entry, 0);
+        }
+        slot_of.emplace(block, slot);
+    }
+    bits[static_cast<size_t>(slot) * words_per_entry + core / 64] |= uint64_t{1} << (core % 64);
+}
+
+void SnoopFilter::remove(uint32_t block, int core) {
+    auto it = slot_of.find(block);
+    if (it == slot_of.end()) return;
+    uint64_t* entry = &bits[static_cast<size_t>(it->second) * words_per_entry];
+    entry[core / 64] &= ~(uint64_t{1} << (core % 64));
+    for (int w = 0; w < words_per_entry; ++w) {
+        if (entry[w]) return;
+    }
+    free_slots.push_back(it->second);
+    slot_of.erase(it);
+}
+
+bool SnoopFilter::holders(uint32_t block, uint64_t* out) const {
+    auto it = slot_of.find(block);
+    if (it == slot_of.end()) return false;
+    const uint64_t* entry = &bits[static_cast<size_t>(it->second) * words_per_entry];
+    for (int w = 0; w < words_per_entry; ++w) out[w] = entry[w];
+    return true;
+}
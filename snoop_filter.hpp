@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Inclusive snoop filter: for every block held valid in at least one L1, a bitmap of the
+// cores that hold it. Kept exact by the controller on fills, evictions and invalidations,
+// so a snoop only needs to visit the cores whose bit is set.
+class SnoopFilter {
+public:
+    struct Stats {
+        uint64_t lookups = 0;        // snoops that consulted the filter
+        uint64_t hits = 0;           // ... and found another core holding the block
+        uint64_t misses = 0;         // ... and found no other holder
+        uint64_t probes_avoided = 0; // per-core cache lookups skipped
+    };
+
+    explicit SnoopFilter(int num_cores = 0);
+
+    void add(uint32_t block, int core);
+    void remove(uint32_t block, int core);
+
+    // Copies the holders of block into out (words_per_entry words); false if no core holds it
+    bool holders(uint32_t block, uint64_t* out) const;
+    int words() const { return words_per_entry; }
+
+    Stats stats;
+
+private:
+    int words_per_entry;
+    std::unordered_map<uint32_t, uint32_t> slot_of; // block -> entry index in bits
+    std::vector<uint64_t> bits;                     // entry i occupies [i * words, (i + 1) * words)
+    std::vector<uint32_t> free_slots;
+};
@@ -0,0 +1,225 @@
+#include "split_bus.hpp"
+
+#include <algorithm>
+
+#include "checkpoint.hpp"
+
+SplitBus::SplitBus(const SimConfig& config)
+    : core_stats(config.num_cores), outstanding(config.bus_outstanding), arbitration(config.arbitration),
+      transfer_cycles(config.bus_cycles), block_bits(config.b),
+      core_requests(std::max(1, config.mshrs)), in_flight(config.num_cores, 0) {}
+
+void SplitBus::request(int core, uint32_t addr, bool is_write, uint64_t now) {
+    queue.push_back({core, addr, is_write, now});
+    core_stats[core].requests++;
+    max_queue_depth = std::max(max_queue_depth, queue.size());
+}
+
+bool SplitBus::conflicts(uint32_t block) const {
+    for (const SplitTransaction& t : transactions) {
+        if (!t.posted && t.block == block) return true;
+    }
+    return false;
+}
+
+bool SplitBus::pop_completed(uint64_t now, SplitTransaction& out) {
+    for (size_t i = 0; i < transactions.size(); ++i) {
+        const SplitTransaction& t = transactions[i];
+        if ((t.transferring || !t.grant.has_data) && t.done == now) {
+            out = t;
+            transactions.erase(transactions.begin() + i);
+            if (!out.posted) {
+                in_flight[out.core]--;
+                active--;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void SplitBus::start_transfer(uint64_t now) {
+    if (data_free > now) return;
+    SplitTransaction* next = nullptr;
+    for (SplitTransaction& t : transactions) {
+        if (!t.grant.has_data || t.transferring || t.ready > now) continue;
+        if (!next || t.ready < next->ready) next = &t;
+    }
+    if (!next) return;
+    next->transferring = true;
+    next->done = now + transfer_cycles;
+    data_free = next->done;
+    data_bus_cycles += transfer_cycles;
+    core_stats[next->core].data_bus_cycles += transfer_cycles;
+}
+
+bool SplitBus::arbitrate(uint64_t now, SplitRequest& out) {
+    if (queue.empty() || static_cast<int>(active) >= outstanding) return false;
+    int num_cores = static_cast<int>(in_flight.size());
+    size_t pick = queue.size();
+    for (size_t i = 0; i < queue.size(); ++i) {
+        const SplitRequest& r = queue[i];
+        if (conflicts(r.addr >> block_bits)) continue;
+        if (pick == queue.size()) {
+            pick = i;
+            continue;
+        }
+        const SplitRequest& best = queue[pick];
+        bool better;
+        if (arbitration == Arbitration::AGE) {
+            better = r.cycle < best.cycle || (r.cycle == best.cycle && r.core < best.core);
+        } else {
+            // Distance past the round-robin pointer
+            better = (r.core - next_core + num_cores) % num_cores < (best.core - next_core + num_cores) % num_cores;
+        }
+        if (better) pick = i;
+    }
+    if (pick == queue.size()) return false;
+
+    out = queue[pick];
+    queue.erase(queue.begin() + pick);
+    next_core = (out.core + 1) % num_cores;
+    SplitBusCoreStats& stats = core_stats[out.core];
+    uint64_t waited = now - out.cycle;
+    stats.queue_cycles += waited;
+    stats.max_queue_cycles = std::max(stats.max_queue_cycles, waited);
+    return true;
+}
+
+void SplitBus::issue(const SplitRequest& req, const SplitGrant& grant, uint64_t now) {
+    SplitTransaction t;
+    t.core = req.core;
+    t.addr = req.addr;
+    t.block = req.addr >> block_bits;
+    t.grant = grant;
+    t.ready = now + 1 + grant.latency;
+    if (!grant.has_data) t.done = now + 1;
+    transactions.push_back(t);
+    in_flight[req.core]++;
+    active++;
+    grants++;
+    max_in_flight = std::max(max_in_flight, active);
+}
+
+void SplitBus::post_writeback(int core, uint32_t addr, uint64_t now) {
+    SplitTransaction t;
+    t.core = core;
+    t.addr = addr;
+    t.block = addr >> block_bits;
+    t.grant.type = BusRequestType::FLUSH;
+    t.grant.fill_state = MESIState::INVALID;
+    t.grant.has_data = true;
+    t.grant.from_memory = false;
+    t.grant.latency = 0; // the data is ready at once
+    t.posted = true;
+    t.ready = now;
+    transactions.push_back(t);
+}
+
+uint64_t SplitBus::next_event() const {
+    uint64_t next = UINT64_MAX;
+    for (const SplitTransaction& t : transactions) {
+        if (t.transferring || !t.grant.has_data) {
+            next = std::min(next, t.done);
+        } else {
+            next = std::min(next, std::max(t.ready, data_free));
+        }
+    }
+    return next;
+}
+
+// Requests and transactions are written field by field so that padding never reaches the file
+void SplitBus::save(CheckpointWriter& out) const {
+    out.put<uint64_t>(queue.size());
+    for (const SplitRequest& r : queue) {
+        out.put(r.core);
+        out.put(r.addr);
+        out.put(r.is_write);
+        out.put(r.cycle);
+    }
+    out.put<uint64_t>(transactions.size());
+    for (const SplitTransaction& t : transactions) {
+        out.put(t.core);
+        out.put(t.addr);
+        out.put(t.block);
+        out.put(t.grant.type);
+        out.put(t.grant.fill_state);
+        out.put(t.grant.has_data);
+        out.put(t.grant.from_memory);
+        out.put(t.grant.latency);
+        out.put(t.posted);
+        out.put(t.transferring);
+        out.put(t.ready);
+        out.put(t.done);
+    }
+    out.put_vector(in_flight);
+    out.put<uint64_t>(active);
+    out.put(next_core);
+    out.put(data_free);
+    out.put_vector(core_stats);
+    out.put(grants);
+    out.put(data_bus_cycles);
+    out.put<uint64_t>(max_in_flight);
+    out.put<uint64_t>(max_queue_depth);
+}
+
+// Reads a per-core vector written by put_vector into values, which is already sized per core
+template <typename T>
+static bool get_per_core(CheckpointReader& in, std::vector<T>& values) {
+    uint64_t n = 0;
+    return in.get(n) && n == values.size() && in.get_bytes(values.data(), n * sizeof(T));
+}
+
+const char* SplitBus::load(CheckpointReader& in) {
+    const int num_cores = static_cast<int>(in_flight.size());
+    uint64_t value = 0;
+    in.get(value);
+    if (value > static_cast<uint64_t>(num_cores) * core_requests) return "split bus queue longer than the cores can fill";
+    queue.assign(value, SplitRequest{});
+    for (SplitRequest& r : queue) {
+        in.get(r.core);
+        in.get(r.addr);
+        in.get(r.is_write);
+        in.get(r.cycle);
+        if (r.core < 0 || r.core >= num_cores) return "split bus request from an unknown core";
+    }
+    // Posted writebacks have no configured limit, so the transactions are read one at a time
+    // and a corrupt count runs into the end of the file instead of sizing an allocation
+    in.get(value);
+    transactions.clear();
+    size_t granted = 0;
+    for (uint64_t i = 0; i < value && in.ok(); ++i) {
+        SplitTransaction t;
+        in.get(t.core);
+        in.get(t.addr);
+        in.get(t.block);
+        in.get(t.grant.type);
+        in.get(t.grant.fill_state);
+        in.get(t.grant.has_data);
+        in.get(t.grant.from_memory);
+        in.get(t.grant.latency);
+        in.get(t.posted);
+        in.get(t.transferring);
+        in.get(t.ready);
+        in.get(t.done);
+        if (t.core < 0 || t.core >= num_cores) return "split bus transaction from an unknown core";
+        if (!t.posted && ++granted > static_cast<size_t>(outstanding)) {
+            return "more split bus transactions in flight than --outstanding allows";
+        }
+        transactions.push_back(t);
+    }
+    if (!get_per_core(in, in_flight)) return "truncated or corrupt checkpoint";
+    in.get(value);
+    if (value != granted) return "split bus transaction count is inconsistent";
+    active = value;
+    in.get(next_core);
+    in.get(data_free);
+    if (!get_per_core(in, core_stats)) return "truncated or corrupt checkpoint";
+    in.get(grants);
+    in.get(data_bus_cycles);
+    in.get(value);
+    max_in_flight = value;
+    in.get(value);
+    max_queue_depth = value;
+    return nullptr;
+}
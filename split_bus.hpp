@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "L1simulate.hpp"
+
+class CheckpointWriter;
+class CheckpointReader;
+
+// A core's miss or upgrade waiting for the address bus
+struct SplitRequest {
+    int core;
+    uint32_t addr;
+    bool is_write;
+    uint64_t cycle; // cycle the request was queued
+};
+
+// A granted request (or a posted writeback) between its address phase and its completion
+struct SplitTransaction {
+    int core;
+    uint32_t addr;
+    uint32_t block;
+    SplitGrant grant;
+    bool posted = false;       // victim writeback: no core waits for it
+    bool transferring = false; // holds the data bus
+    uint64_t ready = 0;        // first cycle its data can go on the data bus
+    uint64_t done = 0;         // completion cycle, once known
+};
+
+// Per-core split bus statistics
+struct SplitBusCoreStats {
+    uint64_t requests = 0;
+    uint64_t queue_cycles = 0;     // sum over requests of cycles from queueing to grant
+    uint64_t max_queue_cycles = 0;
+    uint64_t data_bus_cycles = 0;  // data bus cycles spent on this core's fills and writebacks
+};
+
+// Split-transaction snooping bus. The address bus grants one queued request per cycle, in
+// round-robin or age order, while fewer than `outstanding` requests are in flight; the
+// coherence actions happen at the grant. Data responses are ready one cycle later (plus the
+// grant's LLC or memory latency when no cache supplies the block) and then take turns on the
+// data bus, transfer_cycles each. Requests for a block with a transaction in flight wait until it
+// completes, so transactions on the same block never overlap.
+class SplitBus {
+public:
+    SplitBus(const SimConfig& config);
+
+    // Queues a core's request. A blocking core has at most one request queued or in flight,
+    // a non-blocking one up to one per MSHR.
+    void request(int core, uint32_t addr, bool is_write, uint64_t now);
+    bool granted(int core) const { return in_flight[core] != 0; }
+    bool queue_empty() const { return queue.empty(); }
+
+    // Removes a transaction that completes at cycle now; returns false when there are none left
+    bool pop_completed(uint64_t now, SplitTransaction& out);
+    // Puts the oldest ready response on the data bus if it is free
+    void start_transfer(uint64_t now);
+    // Picks the request to grant this cycle, if any
+    bool arbitrate(uint64_t now, SplitRequest& out);
+    void issue(const SplitRequest& req, const SplitGrant& grant, uint64_t now);
+    void post_writeback(int core, uint32_t addr, uint64_t now);
+
+    // Earliest cycle at which a transaction can start or finish a transfer, assuming no
+    // new grants (UINT64_MAX when nothing is in flight)
+    uint64_t next_event() const;
+
+    void save(CheckpointWriter& out) const;
+    // Returns why the saved state cannot be this bus's, or nullptr once it is restored
+    const char* load(CheckpointReader& in);
+
+    std::vector<SplitBusCoreStats> core_stats;
+    uint64_t grants = 0;
+    uint64_t data_bus_cycles = 0;
+    size_t max_in_flight = 0;
+    size_t max_queue_depth = 0;
+
+private:
+    int outstanding;
+    Arbitration arbitration;
+    uint64_t transfer_cycles;
+    int block_bits;
+    int core_requests; // most requests one core can have queued or in flight
+    std::vector<SplitRequest> queue; // in arrival order
+    std::vector<SplitTransaction> transactions;
+    std::vector<uint8_t> in_flight;  // per core: requests granted, not yet completed
+    size_t active = 0;               // transactions counted against `outstanding`
+    int next_core = 0;               // round-robin pointer
+    uint64_t data_free = 0;          // first cycle the data bus is free
+
+    bool conflicts(uint32_t block) const;
+};
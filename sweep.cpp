@@ -0,0 +1,105 @@
+#include "sweep.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+bool parse_int_list(const char* text, std::vector<int>& values) {
+    const char* p = text;
+    while (*p) {
+        char* end;
+        long lo = strtol(p, &end, 10);
+        if (end == p) return false;
+        long hi = lo;
+        p = end;
+        if (*p == '-') {
+            hi = strtol(p + 1, &end, 10);
+            if (end == p + 1 || hi < lo) return false;
+            p = end;
+        }
+        for (long v = lo; v <= hi; ++v) values.push_back(static_cast<int>(v));
+        if (*p == ',') {
+            ++p;
+        } else if (*p) {
+            return false;
+        }
+    }
+    return !values.empty();
+}
+
+std::vector<SweepResult> run_sweep(const std::vector<SimConfig>& configs, const std::vector<TraceSource*>& sources,
+                                   int threads) {
+    std::vector<SweepResult> results(configs.size());
+    if (threads <= 0) threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    threads = std::min<int>(threads, static_cast<int>(configs.size()));
+
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < configs.size(); i = next++) {
+            auto start = std::chrono::steady_clock::now();
+            Simulator sim(configs[i], sources);
+            sim.run();
+            SweepResult& result = results[i];
+            result.config = configs[i];
+            for (const L1Cache& cache : sim.controller.l1_caches) result.cores.push_back(cache.stats);
+            result.bus_transactions = sim.controller.total_bus_transactions;
+            result.bus_traffic_bytes = sim.controller.total_bus_traffic_bytes;
+            result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool) thread.join();
+    return results;
+}
+
+static uint64_t cache_kb(const SimConfig& config) {
+    return ((uint64_t{1} << config.s) * config.E * (uint64_t{1} << config.b)) / 1024;
+}
+
+static double miss_rate(const CacheStats& stats) {
+    return stats.total_instructions ? (100.0 * stats.cache_misses / stats.total_instructions) : 0.0;
+}
+
+void write_sweep_csv(const std::vector<SweepResult>& results, std::ostream& out) {
+    out << "s,E,b,replacement,cache_kb,core,instructions,reads,writes,total_cycles,idle_cycles,misses,miss_rate,"
+           "evictions,writebacks,invalidations,data_traffic_bytes,bus_transactions,bus_traffic_bytes\n";
+    for (const SweepResult& r : results) {
+        for (size_t core = 0; core < r.cores.size(); ++core) {
+            const CacheStats& st = r.cores[core];
+            out << r.config.s << ',' << r.config.E << ',' << r.config.b << ',' << replacement_name(r.config.replacement)
+                << ',' << cache_kb(r.config) << ',' << core << ','
+                << st.total_instructions << ',' << st.total_reads << ',' << st.total_writes << ',' << st.total_cycles << ','
+                << st.idle_cycles << ',' << st.cache_misses << ',' << std::fixed << std::setprecision(2) << miss_rate(st)
+                << ',' << st.cache_evictions << ',' << st.writebacks << ',' << st.bus_invalidations << ','
+                << st.data_traffic_bytes << ',' << r.bus_transactions << ',' << r.bus_traffic_bytes << '\n';
+        }
+    }
+}
+
+void write_sweep_json(const std::vector<SweepResult>& results, std::ostream& out) {
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const SweepResult& r = results[i];
+        out << "  {\"s\": " << r.config.s << ", \"E\": " << r.config.E << ", \"b\": " << r.config.b
+            << ", \"replacement\": \"" << replacement_name(r.config.replacement) << "\""
+            << ", \"cache_kb\": " << cache_kb(r.config) << ", \"bus_transactions\": " << r.bus_transactions
+            << ", \"bus_traffic_bytes\": " << r.bus_traffic_bytes << ", \"seconds\": " << std::fixed
+            << std::setprecision(3) << r.seconds << ",\n   \"cores\": [\n";
+        for (size_t core = 0; core < r.cores.size(); ++core) {
+            const CacheStats& st = r.cores[core];
+            out << "    {\"core\": " << core << ", \"instructions\": " << st.total_instructions
+                << ", \"reads\": " << st.total_reads << ", \"writes\": " << st.total_writes
+                << ", \"total_cycles\": " << st.total_cycles << ", \"idle_cycles\": " << st.idle_cycles
+                << ", \"misses\": " << st.cache_misses << ", \"miss_rate\": " << std::setprecision(2) << miss_rate(st)
+                << ", \"evictions\": " << st.cache_evictions << ", \"writebacks\": " << st.writebacks
+                << ", \"invalidations\": " << st.bus_invalidations << ", \"data_traffic_bytes\": "
+                << st.data_traffic_bytes << "}" << (core + 1 < r.cores.size() ? "," : "") << "\n";
+        }
+        out << "   ]}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <ostream>
+#include <vector>
+
+#include "L1simulate.hpp"
+
+// Outcome of one configuration of a sweep
+struct SweepResult {
+    SimConfig config;
+    std::vector<CacheStats> cores;
+    uint64_t bus_transactions = 0;
+    uint64_t bus_traffic_bytes = 0;
+    double seconds = 0.0; // wall-clock time of this configuration
+};
+
+// Parses "6", "1,2,4" or "4-8" (or a comma list mixing both) and appends the values
+bool parse_int_list(const char* text, std::vector<int>& values);
+
+// Runs every configuration as an independent Simulator over the same trace sources on a
+// pool of worker threads (threads <= 0: one per hardware thread). Results keep the input order.
+std::vector<SweepResult> run_sweep(const std::vector<SimConfig>& configs, const std::vector<TraceSource*>& sources,
+                                   int threads);
+
+// One row per (configuration, core)
+void write_sweep_csv(const std::vector<SweepResult>& results, std::ostream& out);
+// One object per configuration with a per-core array
+void write_sweep_json(const std::vector<SweepResult>& results, std::ostream& out);
@@ -0,0 +1,463 @@
+#include "trace.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+std::string text_trace_path(const std::string& prefix, int core) {
+    return prefix + "_proc" + std::to_string(core) + ".trace";
+}
+
+std::string binary_trace_path(const std::string& prefix, int core) {
+    return prefix + "_proc" + std::to_string(core) + ".btrace";
+}
+
+static bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Parses "<R|W> <hex addr>" from one line [p, end); anything after the address is ignored.
+// Returns nullptr with entry set, or a description of what is wrong with the line. Blank
+// lines set entry.op to 0.
+static const char* parse_trace_line(const char* p, const char* end, TraceEntry& entry) {
+    entry = TraceEntry{};
+    while (p < end && is_blank(*p)) ++p;
+    if (p == end) return nullptr;
+    char op = *p++;
+    if (op != 'R' && op != 'W') return "expected R or W";
+    while (p < end && is_blank(*p)) ++p;
+    if (end - p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) p += 2;
+    uint64_t addr = 0;
+    const char* digits = p;
+    for (; p < end; ++p) {
+        int v = hex_value(*p);
+        if (v < 0) break;
+        addr = (addr << 4) | static_cast<uint64_t>(v);
+    }
+    if (p == digits) return "expected a hex address";
+    if (p - digits > 16) return "address does not fit in 64 bits";
+    if (p < end && !is_blank(*p)) return "invalid hex digit in address";
+    entry.op = op;
+    entry.addr = addr;
+    return nullptr;
+}
+
+// Text traces are read in blocks of this size; a line may not be longer
+static constexpr size_t READ_BUFFER_BYTES = 1 << 20;
+
+bool read_trace(const std::string& filename, std::vector<TraceEntry>& trace, std::ostream& err) {
+    trace.clear();
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        err << "Error: cannot open " << filename << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    struct stat st;
+    uint64_t file_size = fstat(fd, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    std::vector<char> buf(READ_BUFFER_BYTES);
+    size_t len = 0;
+    uint64_t line_no = 0;
+    bool eof = false;
+    bool sized = false;
+    while (!eof || len > 0) {
+        if (!eof) {
+            ssize_t n = ::read(fd, buf.data() + len, buf.size() - len);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) {
+                err << "Error: reading " << filename << ": " << strerror(errno) << "\n";
+                close(fd);
+                return false;
+            }
+            if (n == 0) eof = true;
+            len += static_cast<size_t>(n);
+            if (!eof && len < buf.size()) continue; // parse full buffers only
+        }
+        const char* p = buf.data();
+        const char* end = p + len;
+        if (!sized) {
+            // Size the trace from the line length in the first buffer
+            // (with a little slack, so a slightly longer tail does not double the vector)
+            size_t lines = static_cast<size_t>(std::count(p, end, '\n'));
+            if (lines) trace.reserve(static_cast<size_t>(1.05 * file_size * lines / len) + 1);
+            sized = true;
+        }
+        while (p < end) {
+            const char* nl = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+            if (!nl) {
+                if (!eof) {
+                    if (p != buf.data()) break; // the rest of the line is in the next block
+                    err << "Error: " << filename << ":" << line_no + 1 << ": line longer than "
+                        << READ_BUFFER_BYTES << " bytes\n";
+                    close(fd);
+                    return false;
+                }
+                nl = end; // final line without a newline
+            }
+            line_no++;
+            TraceEntry entry;
+            if (const char* reason = parse_trace_line(p, nl, entry)) {
+                err << "Error: " << filename << ":" << line_no << ": " << reason << ": \""
+                    << std::string(p, std::min<size_t>(nl - p, 64)) << "\"\n";
+                close(fd);
+                return false;
+            }
+            if (entry.op) trace.push_back(entry);
+            p = nl < end ? nl + 1 : end;
+        }
+        len = static_cast<size_t>(end - p);
+        memmove(buf.data(), p, len);
+    }
+    close(fd);
+    return true;
+}
+
+bool load_traces(const std::string& prefix, int num_cores, int threads, std::vector<std::unique_ptr<Trace>>& traces) {
+    traces.clear();
+    traces.resize(num_cores);
+    std::vector<std::ostringstream> errors(num_cores);
+    std::vector<char> ok(num_cores, 0);
+    if (threads <= 0) threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    threads = std::max(1, std::min(threads, num_cores));
+
+    std::atomic<int> next{0};
+    auto worker = [&]() {
+        for (int i = next++; i < num_cores; i = next++) {
+            traces[i] = std::make_unique<Trace>();
+            ok[i] = traces[i]->load(prefix, i, errors[i]);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool) thread.join();
+
+    // Messages in core order, whichever thread found them
+    bool all_ok = true;
+    for (int i = 0; i < num_cores; ++i) {
+        std::cerr << errors[i].str();
+        all_ok = all_ok && ok[i];
+    }
+    return all_ok;
+}
+
+Trace::~Trace() {
+    release();
+}
+
+Trace::Trace(Trace&& other) noexcept {
+    *this = std::move(other);
+}
+
+Trace& Trace::operator=(Trace&& other) noexcept {
+    if (this == &other) return *this;
+    release();
+    owned = std::move(other.owned);
+    mapping = other.mapping;
+    mapping_len = other.mapping_len;
+    count = other.count;
+    data = mapping ? other.data : owned.data();
+    other.data = nullptr;
+    other.count = 0;
+    other.mapping = nullptr;
+    other.mapping_len = 0;
+    return *this;
+}
+
+void Trace::release() {
+    if (mapping) munmap(mapping, mapping_len);
+    mapping = nullptr;
+    mapping_len = 0;
+    owned.clear();
+    data = nullptr;
+    count = 0;
+}
+
+bool Trace::load(const std::string& prefix, int core, std::ostream& err) {
+    release();
+    std::string binfile = binary_trace_path(prefix, core);
+    if (access(binfile.c_str(), F_OK) == 0) return map_binary(binfile, core, err);
+
+    if (!read_trace(text_trace_path(prefix, core), owned, err)) return false;
+    data = owned.data();
+    count = owned.size();
+    return true;
+}
+
+bool Trace::map_binary(const std::string& filename, int core, std::ostream& err) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        err << "Error: cannot open " << filename << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(BinaryTraceHeader)) {
+        err << "Error: " << filename << " is too short to be a binary trace\n";
+        close(fd);
+        return false;
+    }
+    size_t len = static_cast<size_t>(st.st_size);
+    void* map = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        err << "Error: cannot map " << filename << ": " << strerror(errno) << "\n";
+        return false;
+    }
+
+    const auto* header = static_cast<const BinaryTraceHeader*>(map);
+    const char* reason = nullptr;
+    if (memcmp(header->magic, BINARY_TRACE_MAGIC, sizeof(header->magic)) != 0) reason = "bad magic";
+    else if (header->version != BINARY_TRACE_VERSION) reason = "unsupported version";
+    else if (header->record_size != sizeof(TraceEntry)) reason = "unexpected record size";
+    else if (header->core_id != static_cast<uint32_t>(core)) reason = "core id does not match file name";
+    else if (header->record_count > (len - sizeof(BinaryTraceHeader)) / sizeof(TraceEntry)) reason = "truncated";
+    if (reason) {
+        err << "Error: " << filename << ": " << reason << "\n";
+        munmap(map, len);
+        return false;
+    }
+
+    madvise(map, len, MADV_SEQUENTIAL);
+    mapping = map;
+    mapping_len = len;
+    data = reinterpret_cast<const TraceEntry*>(static_cast<const char*>(map) + sizeof(BinaryTraceHeader));
+    count = header->record_count;
+    return true;
+}
+
+bool convert_trace(const std::string& prefix, int core) {
+    std::string infile = text_trace_path(prefix, core);
+    std::string outfile = binary_trace_path(prefix, core);
+    std::vector<TraceEntry> trace;
+    if (!read_trace(infile, trace)) return false;
+    BinaryTraceHeader header{};
+    memcpy(header.magic, BINARY_TRACE_MAGIC, sizeof(header.magic));
+    header.version = BINARY_TRACE_VERSION;
+    header.core_id = static_cast<uint32_t>(core);
+    header.record_size = sizeof(TraceEntry);
+    header.record_count = trace.size();
+
+    std::ofstream fout(outfile, std::ios::binary | std::ios::trunc);
+    fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    fout.write(reinterpret_cast<const char*>(trace.data()), static_cast<std::streamsize>(trace.size() * sizeof(TraceEntry)));
+    if (!fout) {
+        std::cerr << "Error: failed writing " << outfile << "\n";
+        return false;
+    }
+    std::cout << infile << " -> " << outfile << " (" << trace.size() << " records)\n";
+    return true;
+}
+
+StreamTrace::~StreamTrace() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+    }
+    cv.notify_all();
+    // The reader may be blocked waiting for input on a pipe or FIFO whose writer never comes
+    if (wake[1] >= 0) {
+        char byte = 0;
+        while (::write(wake[1], &byte, 1) < 0 && errno == EINTR) {}
+    }
+    if (reader.joinable()) reader.join();
+    if (owns_fd && fd >= 0) ::close(fd);
+    for (int w : wake) {
+        if (w >= 0) ::close(w);
+    }
+}
+
+bool StreamTrace::open(const std::string& path, int core) {
+    this->path = path;
+    this->core = core;
+    if (path == "-") {
+        fd = STDIN_FILENO;
+        owns_fd = false;
+    } else {
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Error: cannot open " << path << ": " << strerror(errno) << "\n";
+            return false;
+        }
+        owns_fd = true;
+    }
+    if (::pipe(wake) != 0) {
+        std::cerr << "Error: " << path << ": " << strerror(errno) << "\n";
+        wake[0] = wake[1] = -1;
+        return false;
+    }
+    for (auto& chunk : chunks) chunk.entries.resize(CHUNK_ENTRIES);
+    reader = std::thread(&StreamTrace::run, this);
+    return true;
+}
+
+bool StreamTrace::fetch(size_t idx, TraceWindow& window) {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        Chunk& chunk = chunks[consumer];
+        cv.wait(lock, [&] { return chunk.full; });
+        if (idx < chunk.start + chunk.len) {
+            if (idx < chunk.start) return false; // streams cannot rewind
+            window = {chunk.entries.data(), chunk.start, chunk.len, chunk.last};
+            return true;
+        }
+        if (chunk.last) {
+            if (chunk.error) error = true;
+            return false;
+        }
+        // The simulator has moved past this chunk; hand it back to the reader.
+        chunk.full = false;
+        consumer ^= 1;
+        cv.notify_all();
+    }
+}
+
+void StreamTrace::run() {
+    std::vector<char> buf(1 << 20);
+    size_t buf_pos = 0, buf_len = 0;
+    bool eof = false;
+    bool failed = false; // the stream ends early after an error, which fetch passes on
+    auto refill = [&]() {
+        if (buf_pos > 0) {
+            memmove(buf.data(), buf.data() + buf_pos, buf_len - buf_pos);
+            buf_len -= buf_pos;
+            buf_pos = 0;
+        }
+        while (!eof && buf_len < buf.size()) {
+            pollfd fds[2] = {{fd, POLLIN, 0}, {wake[0], POLLIN, 0}};
+            if (::poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "Error: reading " << path << ": " << strerror(errno) << "\n";
+                failed = true;
+                eof = true;
+                break;
+            }
+            if (fds[1].revents) { // the destructor is stopping the reader
+                eof = true;
+                break;
+            }
+            ssize_t n = ::read(fd, buf.data() + buf_len, buf.size() - buf_len);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                if (n < 0) {
+                    std::cerr << "Error: reading " << path << ": " << strerror(errno) << "\n";
+                    failed = true;
+                }
+                eof = true;
+                break;
+            }
+            buf_len += static_cast<size_t>(n);
+            if (buf_len >= sizeof(BinaryTraceHeader)) break; // do not wait on a live pipe
+        }
+    };
+
+    // Sniff the format from the first bytes.
+    while (!eof && buf_len < sizeof(BinaryTraceHeader)) refill();
+    bool binary = buf_len >= sizeof(BINARY_TRACE_MAGIC) &&
+                  memcmp(buf.data(), BINARY_TRACE_MAGIC, sizeof(BINARY_TRACE_MAGIC)) == 0;
+    uint64_t remaining = UINT64_MAX;
+    if (binary) {
+        BinaryTraceHeader header;
+        const char* reason = nullptr;
+        if (buf_len < sizeof(header)) {
+            reason = "truncated header";
+        } else {
+            memcpy(&header, buf.data(), sizeof(header));
+            if (header.version != BINARY_TRACE_VERSION) reason = "unsupported version";
+            else if (header.record_size != sizeof(TraceEntry)) reason = "unexpected record size";
+            else if (header.core_id != static_cast<uint32_t>(core)) reason = "core id does not match";
+        }
+        if (reason) {
+            std::cerr << "Error: " << path << ": " << reason << "\n";
+            failed = true;
+            eof = true;
+            buf_len = buf_pos = 0;
+        } else {
+            buf_pos = sizeof(header);
+            remaining = header.record_count;
+        }
+    }
+
+    size_t next_start = 0;
+    uint64_t line_no = 0;
+    int slot = 0;
+    while (true) {
+        Chunk& chunk = chunks[slot];
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [&] { return !chunk.full || stop; });
+            if (stop) return;
+        }
+
+        size_t len = 0;
+        while (len < CHUNK_ENTRIES && !failed) {
+            if (binary) {
+                if (remaining == 0) break;
+                if (buf_len - buf_pos < sizeof(TraceEntry)) {
+                    if (eof) break;
+                    refill();
+                    continue;
+                }
+                memcpy(&chunk.entries[len++], buf.data() + buf_pos, sizeof(TraceEntry));
+                buf_pos += sizeof(TraceEntry);
+                remaining--;
+            } else {
+                const char* begin = buf.data() + buf_pos;
+                const char* nl = static_cast<const char*>(memchr(begin, '\n', buf_len - buf_pos));
+                if (!nl && buf_pos == 0 && buf_len == buf.size()) {
+                    std::cerr << "Error: " << path << ":" << line_no + 1 << ": line longer than " << buf.size()
+                              << " bytes\n";
+                    failed = true;
+                    break;
+                }
+                if (!nl) {
+                    if (!eof) {
+                        refill();
+                        continue;
+                    }
+                    if (buf_pos == buf_len) break;
+                    nl = buf.data() + buf_len; // final line without a newline
+                }
+                line_no++;
+                if (const char* reason = parse_trace_line(begin, nl, chunk.entries[len])) {
+                    std::cerr << "Error: " << path << ":" << line_no << ": " << reason << "\n";
+                    failed = true;
+                    break;
+                }
+                if (chunk.entries[len].op) len++;
+                buf_pos = std::min(buf_len, static_cast<size_t>(nl - buf.data()) + 1);
+            }
+        }
+        bool last = len < CHUNK_ENTRIES || failed || (binary && remaining == 0);
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            chunk.start = next_start;
+            chunk.len = len;
+            chunk.last = last;
+            chunk.error = failed;
+            chunk.full = true;
+        }
+        cv.notify_all();
+        next_start += len;
+        if (last) return;
+        slot ^= 1;
+    }
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A single memory reference. Text traces are parsed into this layout and binary (.btrace)
+// traces store it verbatim, so a memory-mapped file can be indexed in place.
+struct TraceEntry {
+    uint64_t addr;
+    char op; // 'R' or 'W'
+    char pad[7];
+};
+static_assert(sizeof(TraceEntry) == 16, "TraceEntry must match the on-disk record size");
+
+// Binary trace file layout: this header followed by record_count TraceEntry records.
+struct BinaryTraceHeader {
+    char magic[4];          // "L1TB"
+    uint32_t version;
+    uint32_t core_id;
+    uint32_t record_size;   // sizeof(TraceEntry)
+    uint64_t record_count;
+    uint64_t reserved;
+};
+static_assert(sizeof(BinaryTraceHeader) == 32, "BinaryTraceHeader layout changed");
+
+inline constexpr char BINARY_TRACE_MAGIC[4] = {'L', '1', 'T', 'B'};
+inline constexpr uint32_t BINARY_TRACE_VERSION = 1;
+
+// <prefix>_proc<core>.trace and <prefix>_proc<core>.btrace
+std::string text_trace_path(const std::string& prefix, int core);
+std::string binary_trace_path(const std::string& prefix, int core);
+
+// Contiguous run of records [start, start + len) of one core's trace.
+struct TraceWindow {
+    const TraceEntry* data = nullptr;
+    size_t start = 0;
+    size_t len = 0;
+    bool last = false; // no records follow this window
+};
+
+// Source of one core's trace records, exposed as a sequence of windows.
+class TraceSource {
+public:
+    virtual ~TraceSource() = default;
+    // Makes a window containing record idx current. Returns false once idx is past the end.
+    virtual bool fetch(size_t idx, TraceWindow& window) = 0;
+    // Number of records, or UNKNOWN_LENGTH for a stream not yet read to its end
+    static constexpr uint64_t UNKNOWN_LENGTH = UINT64_MAX;
+    virtual uint64_t length() const { return UNKNOWN_LENGTH; }
+    // The trace ended early because it could not be read (reported on stderr); the
+    // statistics of a run over it are meaningless
+    virtual bool failed() const { return false; }
+};
+
+// Per-simulation read position over a TraceSource. Lookups inside the current
+// window are a bounds check and a pointer add; only window changes reach the source.
+class TraceCursor {
+public:
+    TraceCursor() = default;
+    explicit TraceCursor(TraceSource* source) : source(source) {}
+
+    // Returns record idx, or nullptr past the end of the trace.
+    const TraceEntry* at(size_t idx) {
+        size_t offset = idx - window.start;
+        if (offset < window.len) return window.data + offset;
+        if (!source->fetch(idx, window)) return nullptr;
+        return window.data + (idx - window.start);
+    }
+
+    // Number of records from idx to the end of the current window; at(idx) must have succeeded.
+    size_t contiguous(size_t idx) const { return window.start + window.len - idx; }
+    bool window_is_last() const { return window.last; }
+    uint64_t length() const { return source->length(); }
+
+private:
+    TraceSource* source = nullptr;
+    TraceWindow window;
+};
+
+// Read-only view over one core's whole trace. Text traces own their parsed records,
+// binary traces point straight into a private read-only mapping of the file.
+class Trace : public TraceSource {
+public:
+    Trace() = default;
+    ~Trace() override;
+    Trace(const Trace&) = delete;
+    Trace& operator=(const Trace&) = delete;
+    Trace(Trace&& other) noexcept;
+    Trace& operator=(Trace&& other) noexcept;
+
+    const TraceEntry& operator[](size_t i) const { return data[i]; }
+    size_t size() const { return count; }
+
+    bool fetch(size_t idx, TraceWindow& window) override {
+        if (idx >= count) return false;
+        window = {data, 0, count, true};
+        return true;
+    }
+    uint64_t length() const override { return count; }
+
+    // Loads <prefix>_procN.btrace if present, otherwise parses <prefix>_procN.trace.
+    // Returns false (with a message on err) if the file is missing or malformed.
+    bool load(const std::string& prefix, int core, std::ostream& err = std::cerr);
+
+private:
+    const TraceEntry* data = nullptr;
+    size_t count = 0;
+    std::vector<TraceEntry> owned;
+    void* mapping = nullptr;
+    size_t mapping_len = 0;
+
+    bool map_binary(const std::string& filename, int core, std::ostream& err);
+    void release();
+};
+
+// Streams one core's trace (text or binary) from a file, named pipe or stdin ("-").
+// A background thread fills two fixed-size chunks in turn while the simulator consumes
+// the other one, so memory use does not depend on the trace length.
+class StreamTrace : public TraceSource {
+public:
+    static constexpr size_t CHUNK_ENTRIES = 1 << 16;
+
+    StreamTrace() = default;
+    ~StreamTrace() override;
+    StreamTrace(const StreamTrace&) = delete;
+    StreamTrace& operator=(const StreamTrace&) = delete;
+
+    bool open(const std::string& path, int core);
+    bool fetch(size_t idx, TraceWindow& window) override;
+    bool failed() const override { return error; }
+
+private:
+    struct Chunk {
+        std::vector<TraceEntry> entries;
+        size_t start = 0;
+        size_t len = 0;
+        bool full = false; // filled by the reader, not yet released by the consumer
+        bool last = false;
+        bool error = false; // last, because of a read or format error
+    };
+
+    Chunk chunks[2];
+    int consumer = 0;
+    bool error = false; // the consumer reached the end of a failed stream
+    int fd = -1;
+    bool owns_fd = false;
+    int wake[2] = {-1, -1}; // pipe the destructor writes to, to stop a reader blocked on fd
+    int core = 0;
+    std::string path;
+    bool stop = false;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread reader;
+
+    void run();
+};
+
+// Parses a text trace into trace. Returns false, reporting the file and line number on err,
+// if the file cannot be read or a line is not "<R|W> <hex address>"; blank lines are skipped.
+bool read_trace(const std::string& filename, std::vector<TraceEntry>& trace, std::ostream& err = std::cerr);
+
+// Loads every core's trace (Trace::load) on up to `threads` threads (0 = all hardware
+// threads). Messages go to stderr in core order; returns false if any trace failed.
+bool load_traces(const std::string& prefix, int num_cores, int threads, std::vector<std::unique_ptr<Trace>>& traces);
+
+// Converts <prefix>_procN.trace to <prefix>_procN.btrace.
+bool convert_trace(const std::string& prefix, int core);
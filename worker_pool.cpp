@@ -0,0 +1,53 @@
+#include "worker_pool.hpp"
+
+// Polls before a worker falls back to sleeping on the condition variable
+static constexpr int SPIN_LIMIT = 4096;
+
+WorkerPool::WorkerPool(int workers) : workers(workers < 1 ? 1 : workers) {
+    for (int i = 1; i < this->workers; ++i) threads.emplace_back(&WorkerPool::loop, this, i);
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+    }
+    cv.notify_all();
+    for (auto& thread : threads) thread.join();
+}
+
+void WorkerPool::run(const std::function<void(int)>& job) {
+    if (workers == 1) {
+        job(0);
+        return;
+    }
+    this->job = &job;
+    pending.store(workers - 1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        generation.fetch_add(1, std::memory_order_release);
+    }
+    cv.notify_all();
+
+    job(0);
+    while (pending.load(std::memory_order_acquire) != 0) std::this_thread::yield();
+}
+
+void WorkerPool::loop(int index) {
+    uint64_t seen = 0;
+    while (true) {
+        int spins = 0;
+        while (generation.load(std::memory_order_acquire) == seen && !stop.load(std::memory_order_acquire)) {
+            if (++spins < SPIN_LIMIT) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [&] { return generation.load(std::memory_order_acquire) != seen || stop.load(); });
+        }
+        if (stop.load(std::memory_order_acquire)) return;
+        seen = generation.load(std::memory_order_acquire);
+        (*job)(index);
+        pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
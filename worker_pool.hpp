@@ -0,0 +1,34 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads that run one job at a time in lock step: run(job) calls job(i) for
+// every worker index i (index 0 on the calling thread) and returns when all have finished.
+// Workers spin briefly between jobs before sleeping, since jobs arrive in quick succession.
+class WorkerPool {
+public:
+    explicit WorkerPool(int workers);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    int size() const { return workers; }
+    void run(const std::function<void(int)>& job);
+
+private:
+    int workers;
+    std::vector<std::thread> threads;
+    const std::function<void(int)>* job = nullptr;
+    std::atomic<uint64_t> generation{0};
+    std::atomic<int> pending{0};
+    std::atomic<bool> stop{false};
+    std::mutex mtx;
+    std::condition_variable cv;
+
+    void loop(int index);
+};